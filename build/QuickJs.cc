@@ -1,466 +1,4060 @@
 #include "quickjs-libc.h"
+#include <atomic>
+#include <chrono>
 #include <string>
 #include <cstring>
+#include <cstdio>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#if defined(__APPLE__)
+#include <malloc/malloc.h>
+#else
+#include <malloc.h>
+#endif
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//---------------- 设置导出名 `EXPORT` (全大写可加下划线、可自定义,例如 ASD_API)
+#ifdef _WIN32
+#define EXPORT __declspec(dllexport)
+#else
+#define EXPORT
+#endif
+
+//---------------- 值句柄
+// 返回给PHP的JS值都登记在运行时的句柄表中, 由PHP显式释放;
+// 句柄低24位为槽位序号+1, 其上39位为槽位的复用代数, 用于识别已释放的句柄, 0为无效句柄;
+// 释放的槽位先进先出, 空闲槽位超过 QUICKJS_HANDLE_QUARANTINE 个时才复用, 代数不会在运行时的生命周期内回绕
+typedef int64_t QuickJSHandle_t;
+
+static const uint32_t QUICKJS_HANDLE_INDEX_BITS = 24;
+static const uint32_t QUICKJS_HANDLE_INDEX_MASK = (1u << QUICKJS_HANDLE_INDEX_BITS) - 1;
+static const uint64_t QUICKJS_HANDLE_GENERATION_MASK = (1ull << (63 - QUICKJS_HANDLE_INDEX_BITS)) - 1;
+static const size_t QUICKJS_HANDLE_QUARANTINE = 256;
+
+/**
+ * @brief 拷贝字符串到调用方缓冲区, 总是以'\0'结尾
+ *
+ * @param str
+ * @param len
+ * @param buf
+ * @param buf_len
+ * @return size_t 字符串完整长度
+ */
+static size_t quickjs_copy_string(const char *str, size_t len, char *buf, size_t buf_len)
+{
+    if (buf && buf_len > 0)
+    {
+        size_t n = len < buf_len - 1 ? len : buf_len - 1;
+        memcpy(buf, str, n);
+        buf[n] = '\0';
+    }
+    return len;
+}
+
+//---------------- 预编译脚本 (字节码缓存)
+// 磁盘缓存文件头: 魔数 + 源码hash + 源码长度, 之后为源码原文和 JS_WriteObject 输出的字节码;
+// 读取时逐字节比对源码, hash碰撞的文件不会被当作命中
+static const char QUICKJS_CACHE_MAGIC[4] = {'Q', 'J', 'S', '2'};
+
+struct QuickJSScript
+{
+    uint64_t hash;                                    // 源码hash
+    size_t source_len;                                // 源码长度
+    std::shared_ptr<const std::vector<uint8_t>> code; // 字节码, 同一份源码在进程内共享
+};
+
+/**
+ * @brief 计算源码hash (FNV-1a 64位)
+ *
+ * @param str
+ * @param len
+ * @return uint64_t
+ */
+static uint64_t quickjs_hash_source(const char *str, size_t len)
+{
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++)
+    {
+        h ^= (uint8_t)str[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+/**
+ * @brief 进程内字节码缓存, PHP-FPM 每个worker进程内所有运行时共享
+ */
+class QuickJSScriptCache
+{
+public:
+    static QuickJSScriptCache &instance()
+    {
+        static QuickJSScriptCache cache;
+        return cache;
+    }
+
+    std::shared_ptr<const std::vector<uint8_t>> get(uint64_t hash, const char *source, size_t len)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(hash);
+        if (it == entries.end() || it->second.source.size() != len ||
+            memcmp(it->second.source.data(), source, len) != 0)
+        {
+            return nullptr;
+        }
+        return it->second.code;
+    }
+
+    void put(uint64_t hash, const char *source, size_t len, std::shared_ptr<const std::vector<uint8_t>> code)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Entry &entry = entries[hash];
+        entry.source.assign(source, len);
+        entry.code = std::move(code);
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.clear();
+    }
+
+private:
+    struct Entry
+    {
+        std::string source;
+        std::shared_ptr<const std::vector<uint8_t>> code;
+    };
+
+    std::mutex mutex;
+    std::unordered_map<uint64_t, Entry> entries;
+};
+
+/**
+ * @brief 拼接磁盘缓存文件路径 `<dir>/<hash>.qjsc`
+ *
+ * @param dir
+ * @param hash
+ * @return std::string
+ */
+static std::string quickjs_cache_path(const char *dir, uint64_t hash)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.qjsc", (unsigned long long)hash);
+    std::string path(dir);
+    if (!path.empty() && path.back() != '/' && path.back() != '\\')
+    {
+        path += '/';
+    }
+    return path + name;
+}
+
+/**
+ * @brief 检查缓存目录或文件是否只有当前用户可写
+ *
+ * 缓存中的字节码不经校验直接交给 JS_ReadObject, 其他用户可写时可能被植入恶意字节码;
+ * Windows 上不检查, 由目录ACL保证
+ *
+ * @param st
+ * @return bool 属主为当前用户且组和其他用户不可写
+ */
+#ifndef _WIN32
+static bool quickjs_cache_trusted(const struct stat &st)
+{
+    return st.st_uid == geteuid() && !(st.st_mode & (S_IWGRP | S_IWOTH));
+}
+#endif
+
+/**
+ * @brief 检查磁盘缓存目录, 不是当前用户独占的目录时不使用磁盘缓存
+ *
+ * @param dir
+ * @return bool
+ */
+static bool quickjs_cache_dir_trusted(const char *dir)
+{
+#ifndef _WIN32
+    struct stat st;
+    return stat(dir, &st) == 0 && S_ISDIR(st.st_mode) && quickjs_cache_trusted(st);
+#else
+    return true;
+#endif
+}
+
+/**
+ * @brief 从磁盘缓存读取字节码, 文件不存在、不是当前用户独占或源码不一致时返回nullptr
+ *
+ * @param dir
+ * @param hash
+ * @param source
+ * @param source_len
+ * @return std::shared_ptr<const std::vector<uint8_t>>
+ */
+static std::shared_ptr<const std::vector<uint8_t>> quickjs_cache_load(const char *dir, uint64_t hash, const char *source, size_t source_len)
+{
+    FILE *f = fopen(quickjs_cache_path(dir, hash).c_str(), "rb");
+    if (!f)
+    {
+        return nullptr;
+    }
+#ifndef _WIN32
+    struct stat st;
+    if (fstat(fileno(f), &st) != 0 || !S_ISREG(st.st_mode) || !quickjs_cache_trusted(st))
+    {
+        fclose(f);
+        return nullptr;
+    }
+#endif
+    char magic[4];
+    uint64_t file_hash = 0, file_len = 0;
+    bool ok = fread(magic, 1, 4, f) == 4 && memcmp(magic, QUICKJS_CACHE_MAGIC, 4) == 0 &&
+              fread(&file_hash, sizeof(file_hash), 1, f) == 1 && file_hash == hash &&
+              fread(&file_len, sizeof(file_len), 1, f) == 1 && file_len == source_len;
+    std::vector<uint8_t> code;
+    if (ok)
+    {
+        std::string file_source(source_len, '\0');
+        ok = fread(&file_source[0], 1, source_len, f) == source_len && memcmp(file_source.data(), source, source_len) == 0;
+    }
+    if (ok)
+    {
+        uint8_t buf[4096];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        {
+            code.insert(code.end(), buf, buf + n);
+        }
+        ok = !ferror(f) && !code.empty();
+    }
+    fclose(f);
+    if (!ok)
+    {
+        return nullptr;
+    }
+    return std::make_shared<const std::vector<uint8_t>>(std::move(code));
+}
+
+/**
+ * @brief 写入磁盘缓存, 先写临时文件再重命名, 避免并发进程读到半个文件
+ *
+ * 临时文件名取进程号+进程内序号; fork 出的 PHP-FPM worker 堆地址相同, 不能用指针区分
+ *
+ * @param dir
+ * @param script
+ * @param source
+ * @return bool
+ */
+static bool quickjs_cache_store(const char *dir, const QuickJSScript *script, const char *source)
+{
+    static std::atomic<uint64_t> tmp_seq(0);
+    std::string path = quickjs_cache_path(dir, script->hash);
+    std::string tmp = path + "." + std::to_string((long long)getpid()) + "." + std::to_string(tmp_seq++) + ".tmp";
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if (!f)
+    {
+        return false;
+    }
+    uint64_t len = script->source_len;
+    bool ok = fwrite(QUICKJS_CACHE_MAGIC, 1, 4, f) == 4 &&
+              fwrite(&script->hash, sizeof(script->hash), 1, f) == 1 &&
+              fwrite(&len, sizeof(len), 1, f) == 1 &&
+              fwrite(source, 1, script->source_len, f) == script->source_len &&
+              fwrite(script->code->data(), 1, script->code->size(), f) == script->code->size();
+    ok = fclose(f) == 0 && ok;
+    if (ok)
+    {
+#ifdef _WIN32
+        remove(path.c_str());
+#endif
+        ok = rename(tmp.c_str(), path.c_str()) == 0;
+    }
+    if (!ok)
+    {
+        remove(tmp.c_str());
+    }
+    return ok;
+}
+
+//---------------- 结构化数据二进制格式
+// 小端, 每个值以1字节类型开头, 长度均为uint32;
+// 类型化数组的数据按元素大小相对缓冲区起始位置对齐, PHP FFI 可直接转换指针读取
+enum QuickJSMarshalType
+{
+    QUICKJS_MARSHAL_UNDEFINED = 0,
+    QUICKJS_MARSHAL_NULL = 1,
+    QUICKJS_MARSHAL_FALSE = 2,
+    QUICKJS_MARSHAL_TRUE = 3,
+    QUICKJS_MARSHAL_INT = 4,           // int32
+    QUICKJS_MARSHAL_DOUBLE = 5,        // float64
+    QUICKJS_MARSHAL_STRING = 6,        // len + utf8
+    QUICKJS_MARSHAL_ARRAY = 7,         // count + count个值
+    QUICKJS_MARSHAL_OBJECT = 8,        // count + count个(键长度 + 键 + 值)
+    QUICKJS_MARSHAL_UINT8_ARRAY = 9,   // count + 数据
+    QUICKJS_MARSHAL_INT32_ARRAY = 10,  // count + 对齐 + 数据
+    QUICKJS_MARSHAL_FLOAT64_ARRAY = 11 // count + 对齐 + 数据
+};
+
+// 嵌套层数上限, 同时用于防止循环引用
+static const int QUICKJS_MARSHAL_MAX_DEPTH = 256;
+// 未设置内存上限时的输出大小上限
+static const size_t QUICKJS_MARSHAL_MAX_SIZE = 256 * 1024 * 1024;
+// 数组/对象每写入多少个元素检查一次截止时间
+static const uint32_t QUICKJS_MARSHAL_CHECK_INTERVAL = 1024;
+
+/**
+ * @brief 类型化数组的元素大小
+ *
+ * @param type
+ * @return size_t 不是类型化数组返回0
+ */
+static size_t quickjs_marshal_element_size(int type)
+{
+    switch (type)
+    {
+    case QUICKJS_MARSHAL_UINT8_ARRAY:
+        return 1;
+    case QUICKJS_MARSHAL_INT32_ARRAY:
+        return 4;
+    case QUICKJS_MARSHAL_FLOAT64_ARRAY:
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+/**
+ * @brief 类型化数组的构造函数名
+ *
+ * @param type
+ * @return const char*
+ */
+static const char *quickjs_marshal_typed_array_name(int type)
+{
+    switch (type)
+    {
+    case QUICKJS_MARSHAL_UINT8_ARRAY:
+        return "Uint8Array";
+    case QUICKJS_MARSHAL_INT32_ARRAY:
+        return "Int32Array";
+    case QUICKJS_MARSHAL_FLOAT64_ARRAY:
+        return "Float64Array";
+    default:
+        return NULL;
+    }
+}
+
+//---------------- 运行时专用分配器
+// 小块按大小分级, 从整块内存(arena)中顺序切分, 释放后进入对应级别的空闲链表复用;
+// 超过 QUICKJS_ARENA_MAX_SMALL 的大块直接使用 malloc。运行时销毁时整块归还, 不再逐个 free
+static const size_t QUICKJS_ARENA_ALIGN = 16;
+static const size_t QUICKJS_ARENA_MAX_SMALL = 4096;
+static const size_t QUICKJS_ARENA_DEFAULT_CHUNK = 256 * 1024;
+static const uint32_t QUICKJS_ARENA_LARGE = 0xffffffff;
+
+// 每个内存块前的头部, 保持16字节对齐
+struct QuickJSArenaHeader
+{
+    size_t size;  // 可用大小
+    uint32_t cls; // 大小级别, 大块为 QUICKJS_ARENA_LARGE
+    uint32_t reserved;
+};
+
+// 分配器统计
+struct QuickJSAllocStats
+{
+    size_t peak;          // 峰值使用字节
+    size_t used;          // 当前使用字节
+    size_t reserved;      // 向系统申请的字节 (arena + 大块)
+    size_t free_list;     // 空闲链表中的字节
+    size_t arena_count;   // arena 数量
+    size_t large_count;   // 当前大块数量
+    size_t alloc_count;   // 累计分配次数
+    double fragmentation; // 1 - used / reserved
+};
+
+class QuickJSArena
+{
+public:
+    explicit QuickJSArena(size_t chunk_size) : chunk_size(chunk_size ? chunk_size : QUICKJS_ARENA_DEFAULT_CHUNK)
+    {
+        // 16..256 每16字节一级, 之后每级增加1/4
+        size_t size = QUICKJS_ARENA_ALIGN;
+        while (size <= QUICKJS_ARENA_MAX_SMALL)
+        {
+            class_sizes.push_back(size);
+            size += size < 256 ? QUICKJS_ARENA_ALIGN : (size / 4 + QUICKJS_ARENA_ALIGN - 1) & ~(QUICKJS_ARENA_ALIGN - 1);
+        }
+        if (class_sizes.back() != QUICKJS_ARENA_MAX_SMALL)
+        {
+            class_sizes.push_back(QUICKJS_ARENA_MAX_SMALL);
+        }
+        free_lists.assign(class_sizes.size(), NULL);
+        for (size_t i = 0, cls = 0; i < QUICKJS_ARENA_MAX_SMALL / QUICKJS_ARENA_ALIGN; i++)
+        {
+            while (class_sizes[cls] < (i + 1) * QUICKJS_ARENA_ALIGN)
+            {
+                cls++;
+            }
+            class_index[i] = (uint8_t)cls;
+        }
+    }
+    ~QuickJSArena()
+    {
+        for (void *chunk : chunks)
+        {
+            free(chunk);
+        }
+        for (void *block : large_blocks)
+        {
+            free(block);
+        }
+    }
+
+    // 禁用拷贝构造函数和赋值操作符以防止资源双重释放等问题
+    QuickJSArena(const QuickJSArena &) = delete;
+    QuickJSArena &operator=(const QuickJSArena &) = delete;
+
+    void *alloc(size_t size)
+    {
+        QuickJSArenaHeader *header;
+        if (size > QUICKJS_ARENA_MAX_SMALL)
+        {
+            size = (size + QUICKJS_ARENA_ALIGN - 1) & ~(QUICKJS_ARENA_ALIGN - 1);
+            header = (QuickJSArenaHeader *)malloc(sizeof(QuickJSArenaHeader) + size);
+            if (!header)
+            {
+                return NULL;
+            }
+            header->cls = QUICKJS_ARENA_LARGE;
+            large_blocks.insert(header);
+            stats.reserved += sizeof(QuickJSArenaHeader) + size;
+        }
+        else
+        {
+            uint32_t cls = class_index[(size ? size - 1 : 0) / QUICKJS_ARENA_ALIGN];
+            size = class_sizes[cls];
+            if (free_lists[cls])
+            {
+                header = (QuickJSArenaHeader *)free_lists[cls];
+                free_lists[cls] = *(void **)(header + 1);
+                stats.free_list -= size;
+            }
+            else
+            {
+                header = (QuickJSArenaHeader *)bump(sizeof(QuickJSArenaHeader) + size);
+                if (!header)
+                {
+                    return NULL;
+                }
+            }
+            header->cls = cls;
+        }
+        header->size = size;
+        stats.used += size;
+        stats.alloc_count++;
+        if (stats.used > stats.peak)
+        {
+            stats.peak = stats.used;
+        }
+        return header + 1;
+    }
+
+    void release(void *ptr)
+    {
+        QuickJSArenaHeader *header = (QuickJSArenaHeader *)ptr - 1;
+        stats.used -= header->size;
+        if (header->cls == QUICKJS_ARENA_LARGE)
+        {
+            large_blocks.erase(header);
+            stats.reserved -= sizeof(QuickJSArenaHeader) + header->size;
+            free(header);
+            return;
+        }
+        *(void **)ptr = free_lists[header->cls];
+        free_lists[header->cls] = header;
+        stats.free_list += header->size;
+    }
+
+    static size_t usable_size(const void *ptr)
+    {
+        return ptr ? ((const QuickJSArenaHeader *)ptr - 1)->size : 0;
+    }
+
+    QuickJSAllocStats get_stats() const
+    {
+        QuickJSAllocStats out = stats;
+        out.arena_count = chunks.size();
+        out.large_count = large_blocks.size();
+        out.fragmentation = out.reserved ? 1.0 - (double)out.used / (double)out.reserved : 0.0;
+        return out;
+    }
+
+private:
+    void *bump(size_t size)
+    {
+        if ((size_t)(chunk_end - chunk_pos) < size)
+        {
+            // 当前 arena 剩余部分直接丢弃, 计入碎片
+            size_t n = size > chunk_size ? size : chunk_size;
+            uint8_t *chunk = (uint8_t *)malloc(n);
+            if (!chunk)
+            {
+                return NULL;
+            }
+            chunks.push_back(chunk);
+            chunk_pos = chunk;
+            chunk_end = chunk + n;
+            stats.reserved += n;
+        }
+        void *ptr = chunk_pos;
+        chunk_pos += size;
+        return ptr;
+    }
+
+    size_t chunk_size;
+    std::vector<size_t> class_sizes;
+    uint8_t class_index[QUICKJS_ARENA_MAX_SMALL / QUICKJS_ARENA_ALIGN];
+    std::vector<void *> free_lists;
+    std::vector<void *> chunks;
+    std::unordered_set<void *> large_blocks;
+    uint8_t *chunk_pos = NULL;
+    uint8_t *chunk_end = NULL;
+    QuickJSAllocStats stats = {};
+
+public:
+    uint64_t limit_hits = 0; // 超出内存上限被拒绝的分配次数
+};
+
+static void *quickjs_arena_malloc(JSMallocState *s, size_t size)
+{
+    if (s->malloc_size + size > s->malloc_limit)
+    {
+        ((QuickJSArena *)s->opaque)->limit_hits++;
+        return NULL;
+    }
+    void *ptr = ((QuickJSArena *)s->opaque)->alloc(size);
+    if (!ptr)
+    {
+        return NULL;
+    }
+    s->malloc_count++;
+    s->malloc_size += QuickJSArena::usable_size(ptr) + sizeof(QuickJSArenaHeader);
+    return ptr;
+}
+
+static void quickjs_arena_free(JSMallocState *s, void *ptr)
+{
+    if (!ptr)
+    {
+        return;
+    }
+    s->malloc_count--;
+    s->malloc_size -= QuickJSArena::usable_size(ptr) + sizeof(QuickJSArenaHeader);
+    ((QuickJSArena *)s->opaque)->release(ptr);
+}
+
+static void *quickjs_arena_realloc(JSMallocState *s, void *ptr, size_t size)
+{
+    if (!ptr)
+    {
+        return size ? quickjs_arena_malloc(s, size) : NULL;
+    }
+    if (size == 0)
+    {
+        quickjs_arena_free(s, ptr);
+        return NULL;
+    }
+    size_t old_size = QuickJSArena::usable_size(ptr);
+    if (size <= old_size && (size > old_size / 2 || old_size <= QUICKJS_ARENA_ALIGN))
+    {
+        return ptr;
+    }
+    void *new_ptr = quickjs_arena_malloc(s, size);
+    if (!new_ptr)
+    {
+        return NULL;
+    }
+    memcpy(new_ptr, ptr, old_size < size ? old_size : size);
+    quickjs_arena_free(s, ptr);
+    return new_ptr;
+}
+
+static const JSMallocFunctions quickjs_arena_functions = {
+    quickjs_arena_malloc,
+    quickjs_arena_free,
+    quickjs_arena_realloc,
+    QuickJSArena::usable_size,
+};
+
+//---------------- 计数分配器
+// 与 quickjs.c 的默认分配器相同, 另外累计分配次数和超出内存上限的次数 (opaque 为 QuickJSAllocCounter)
+#if defined(__APPLE__)
+static const size_t QUICKJS_MALLOC_OVERHEAD = 0;
+#else
+static const size_t QUICKJS_MALLOC_OVERHEAD = 8;
+#endif
+
+struct QuickJSAllocCounter
+{
+    uint64_t allocations; // 分配次数 (含 realloc)
+    uint64_t limit_hits;  // 超出内存上限被拒绝的次数
+};
+
+static size_t quickjs_counting_usable_size(const void *ptr)
+{
+#if defined(__APPLE__)
+    return malloc_size(ptr);
+#elif defined(_WIN32)
+    return _msize((void *)ptr);
+#else
+    return malloc_usable_size((void *)ptr);
+#endif
+}
+
+static void *quickjs_counting_malloc(JSMallocState *s, size_t size)
+{
+    if (s->malloc_size + size > s->malloc_limit)
+    {
+        ((QuickJSAllocCounter *)s->opaque)->limit_hits++;
+        return NULL;
+    }
+    void *ptr = malloc(size);
+    if (!ptr)
+    {
+        return NULL;
+    }
+    s->malloc_count++;
+    s->malloc_size += quickjs_counting_usable_size(ptr) + QUICKJS_MALLOC_OVERHEAD;
+    ((QuickJSAllocCounter *)s->opaque)->allocations++;
+    return ptr;
+}
+
+static void quickjs_counting_free(JSMallocState *s, void *ptr)
+{
+    if (!ptr)
+    {
+        return;
+    }
+    s->malloc_count--;
+    s->malloc_size -= quickjs_counting_usable_size(ptr) + QUICKJS_MALLOC_OVERHEAD;
+    free(ptr);
+}
+
+static void *quickjs_counting_realloc(JSMallocState *s, void *ptr, size_t size)
+{
+    if (!ptr)
+    {
+        return size ? quickjs_counting_malloc(s, size) : NULL;
+    }
+    size_t old_size = quickjs_counting_usable_size(ptr);
+    if (size == 0)
+    {
+        quickjs_counting_free(s, ptr);
+        return NULL;
+    }
+    if (s->malloc_size + size - old_size > s->malloc_limit)
+    {
+        ((QuickJSAllocCounter *)s->opaque)->limit_hits++;
+        return NULL;
+    }
+    ptr = realloc(ptr, size);
+    if (!ptr)
+    {
+        return NULL;
+    }
+    s->malloc_size += quickjs_counting_usable_size(ptr) - old_size;
+    ((QuickJSAllocCounter *)s->opaque)->allocations++;
+    return ptr;
+}
+
+static const JSMallocFunctions quickjs_counting_functions = {
+    quickjs_counting_malloc,
+    quickjs_counting_free,
+    quickjs_counting_realloc,
+    quickjs_counting_usable_size,
+};
+
+//---------------- 资源限制
+// 超时检查挂在 JS_SetInterruptHandler 上, QuickJS 每执行约一万条指令回调一次,
+// 每 check_interval 次回调才读取一次单调时钟, 尽量减少对执行的影响
+
+// 自动GC阈值的初值, 与 quickjs.c 的 JS_NewRuntime 相同, 之后每次自动GC按当时的内存重新计算
+static const size_t QUICKJS_DEFAULT_GC_THRESHOLD = 256 * 1024;
+// 内存不足时 QuickJS 抛出 null, 以此代替
+static const char QUICKJS_OUT_OF_MEMORY[] = "InternalError: out of memory";
+
+// 最近一次执行的资源使用
+struct QuickJSEvalUsage
+{
+    uint64_t elapsed_us;      // 执行耗时 (微秒)
+    int64_t malloc_size;      // 执行后已分配字节, 未开启内存统计时为-1
+    int64_t malloc_delta;     // 执行前后已分配字节的变化
+    int64_t malloc_count;     // 执行后已分配块数
+    int64_t memory_used_size; // 执行后运行时内部对象占用字节
+    int32_t interrupted;      // 是否因超时被中断
+    int32_t reserved;
+};
+
+/**
+ * @brief 单调时钟 (微秒)
+ *
+ * @return uint64_t
+ */
+static uint64_t quickjs_now_us()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// 运行时累计计数, quickjs_reset 不会清零
+struct QuickJSCounters
+{
+    uint64_t evals;       // 执行次数 (eval/run_compiled/call/eval_to_buffer)
+    uint64_t allocations; // 分配次数 (含 realloc)
+    uint64_t gc_runs;     // GC次数, 包括自动触发的GC
+    uint64_t parse_us;    // 解析耗时 (微秒), 包括 quickjs_compile
+    uint64_t execute_us;  // 执行耗时 (微秒), 包括任务和定时器
+    uint64_t host_calls;  // 宿主函数调用次数
+    uint64_t jobs;        // 执行的任务和定时器个数
+};
+
+//---------------- 宿主函数
+// 所有宿主函数共用一个C入口, 按 function_id 回调宿主注册的分发函数;
+// 参数登记为句柄传入, 调用返回后自动释放, 返回值句柄的所有权交给运行时 (0 为 undefined)
+typedef QuickJSHandle_t (*QuickJSHostCallback)(void *quickjs, int32_t function_id, int argc, const QuickJSHandle_t *argv);
+
+class QuickJS
+{
+public:
+    QuickJS() : rt(JS_NewRuntime2(&quickjs_counting_functions, &alloc_counter)), ctx(JS_NewContext(rt))
+    {
+        JS_SetContextOpaque(ctx, this);
+        install_timers();
+        install_gc_sentinel();
+        save_baseline();
+    }
+    /**
+     * @brief 使用专用分配器创建运行时
+     *
+     * @param chunk_size 每个 arena 的字节数, 0 为默认256KB
+     */
+    explicit QuickJS(size_t chunk_size)
+        : arena(new QuickJSArena(chunk_size)),
+          rt(JS_NewRuntime2(&quickjs_arena_functions, arena.get())),
+          ctx(JS_NewContext(rt))
+    {
+        JS_SetContextOpaque(ctx, this);
+        install_timers();
+        install_gc_sentinel();
+        save_baseline();
+    }
+    ~QuickJS()
+    {
+        // 不需要再调用 quickjs_free()
+        if (debug && (live_handles || invalid_uses))
+        {
+            std::string report(quickjs_debug_report(NULL, 0), '\0');
+            quickjs_debug_report(&report[0], report.size() + 1);
+            fprintf(stderr, "QuickJs: leaked handles\n%s", report.c_str());
+        }
+        quickjs_release_all();
+        clear_timers();
+        for (auto &it : functions)
+        {
+            JS_FreeValue(ctx, it.second.fun);
+        }
+        for (auto &object : baseline)
+        {
+            for (auto &prop : object.props)
+            {
+                JS_FreeAtom(ctx, prop.atom);
+                JS_FreeValue(ctx, prop.value);
+                JS_FreeValue(ctx, prop.getter);
+                JS_FreeValue(ctx, prop.setter);
+            }
+            JS_FreeValue(ctx, object.proto);
+            JS_FreeValue(ctx, object.obj);
+        }
+        JS_FreeValue(ctx, gc_sentinel);
+        JS_FreeContext(ctx);
+        JS_FreeRuntime(rt);
+    }
+
+    // 禁用拷贝构造函数和赋值操作符以防止资源双重释放等问题
+    QuickJS(const QuickJS &) = delete;
+    QuickJS &operator=(const QuickJS &) = delete;
+
+    /**
+     * @brief 执行js代码
+     *
+     * @param js_code
+     * @return QuickJSHandle_t
+     */
+    QuickJSHandle_t quickjs_eval(const char *js_code)
+    {
+        begin_eval();
+        JSValue val = eval_code(js_code);
+        end_eval();
+        return to_handle(val);
+    }
+
+    /**
+     * @brief 判断是否是异常, 无效句柄也视为异常
+     *
+     * @param handle
+     * @return true
+     * @return false
+     */
+    bool quickjs_is_exception(QuickJSHandle_t handle)
+    {
+        return JS_IsException(from_handle(handle));
+    }
+
+    /**
+     * @brief 获取异常信息, 没有新异常时返回本次执行中已取出的信息或无效句柄的错误信息, 都没有时返回空字符串;
+     * 未取走的异常在下次执行开始时丢弃; 超出内存上限时 QuickJS 无法创建错误对象, 本次执行中有分配因上限被拒绝则返回 InternalError: out of memory
+     *
+     * @param buf 调用方缓冲区
+     * @param buf_len
+     * @return size_t 异常信息长度, 大于等于 buf_len 时说明被截断
+     */
+    size_t quickjs_get_exception(char *buf, size_t buf_len)
+    {
+        JSValue val = JS_GetException(ctx);
+        if (!JS_IsNull(val))
+        {
+            size_t len;
+            const char *error = JS_ToCStringLen(ctx, &len, val);
+            if (error)
+            {
+                last_error.assign(error, len);
+                JS_FreeCString(ctx, error);
+            }
+            else
+            {
+                JS_FreeValue(ctx, JS_GetException(ctx));
+                last_error = limit_hits() != eval_limit_hits ? QUICKJS_OUT_OF_MEMORY : "unknown exception";
+            }
+            JS_FreeValue(ctx, val);
+        }
+        else if (last_error.empty() && limit_hits() != eval_limit_hits)
+        {
+            last_error = QUICKJS_OUT_OF_MEMORY;
+        }
+        return quickjs_copy_string(last_error.data(), last_error.size(), buf, buf_len);
+    }
+
+    /**
+     * @brief 转字符串
+     *
+     * @param handle
+     * @param buf 调用方缓冲区
+     * @param buf_len
+     * @return size_t 字符串长度, 大于等于 buf_len 时说明被截断
+     */
+    size_t quickjs_js_ToCString(QuickJSHandle_t handle, char *buf, size_t buf_len)
+    {
+        size_t len;
+        const char *str = JS_ToCStringLen(ctx, &len, from_handle(handle));
+        if (!str)
+        {
+            return quickjs_copy_string("", 0, buf, buf_len);
+        }
+        len = quickjs_copy_string(str, len, buf, buf_len);
+        JS_FreeCString(ctx, str);
+        return len;
+    }
+
+    /**
+     * @brief 转bool
+     *
+     * @param handle
+     * @return int
+     */
+    int quickjs_js_ToBool(QuickJSHandle_t handle)
+    {
+        return JS_ToBool(ctx, from_handle(handle));
+    }
+
+    /**
+     * @brief 转int
+     *
+     * @param handle
+     * @return int
+     */
+    int quickjs_js_ToInt(QuickJSHandle_t handle)
+    {
+        int32_t pres = 0;
+        if (JS_ToInt32(ctx, &pres, from_handle(handle)))
+        {
+            fprintf(stderr, "Error: failed to convert JS value to int.\n");
+        }
+        return pres;
+    }
+
+    /**
+     * @brief 创建一个调用宿主函数的JS函数
+     *
+     * @param name 函数名
+     * @param length 参数个数
+     * @param function_id 宿主分发表中的序号, 调用时原样传给宿主回调
+     * @return QuickJSHandle_t
+     */
+    QuickJSHandle_t quickjs_new_function(const char *name, int length, int32_t function_id)
+    {
+        // magic 只有16位, function_id 放在函数数据中
+        JSValue id = JS_NewInt32(ctx, function_id);
+        JSValue func = JS_NewCFunctionData(ctx, host_trampoline, length, 0, 1, &id);
+        if (!JS_IsException(func) && name && name[0])
+        {
+            JS_DefinePropertyValueStr(ctx, func, "name", JS_NewString(ctx, name), JS_PROP_CONFIGURABLE);
+        }
+        return to_handle(func);
+    }
+
+    /**
+     * @brief 设置宿主回调, 所有宿主函数通过它分发
+     *
+     * @param callback
+     */
+    void quickjs_set_host_callback(QuickJSHostCallback callback)
+    {
+        host_callback = callback;
+    }
+
+    /**
+     * @brief 在宿主回调中调用, 回调返回后向JS抛出 Error
+     *
+     * @param message
+     */
+    void quickjs_throw_error(const char *message)
+    {
+        host_error.assign(message ? message : "");
+        host_error_set = true;
+    }
+
+    /**
+     * @brief 创建一个JS的undefined值
+     *
+     * @return QuickJSHandle_t
+     */
+    QuickJSHandle_t quickjs_new_undefined()
+    {
+        return to_handle(JS_UNDEFINED);
+    }
+
+    /**
+     * @brief 创建一个JS的null值
+     *
+     * @return QuickJSHandle_t
+     */
+    QuickJSHandle_t quickjs_new_null()
+    {
+        return to_handle(JS_NULL);
+    }
+
+    /**
+     * @brief 创建一个JS的true值
+     *
+     * @return QuickJSHandle_t
+     */
+    QuickJSHandle_t quickjs_new_true()
+    {
+        return to_handle(JS_TRUE);
+    }
+
+    /**
+     * @brief 创建一个JS的false值
+     *
+     * @return QuickJSHandle_t
+     */
+    QuickJSHandle_t quickjs_new_false()
+    {
+        return to_handle(JS_FALSE);
+    }
+
+    /**
+     * @brief 创建一个JS的字符串
+     *
+     * @param str
+     * @return QuickJSHandle_t
+     */
+    QuickJSHandle_t quickjs_new_string(const char *str)
+    {
+        return to_handle(JS_NewString(ctx, str));
+    }
+
+    /**
+     * @brief 创建一个JS的int
+     *
+     * @param val
+     * @return QuickJSHandle_t
+     */
+    QuickJSHandle_t quickjs_new_int(int val)
+    {
+        return to_handle(JS_NewInt32(ctx, val));
+    }
+
+    /**
+     * @brief 字符串转json对象
+     *
+     * @param str
+     * @return QuickJSHandle_t
+     */
+    QuickJSHandle_t quickjs_str_to_json(const char *str)
+    {
+        return to_handle(JS_ParseJSON(ctx, str, strlen(str), NULL));
+    }
+
+    /**
+     * @brief 创建一个JS的double
+     *
+     * @param val
+     * @return QuickJSHandle_t
+     */
+    QuickJSHandle_t quickjs_new_double(double val)
+    {
+        return to_handle(JS_NewFloat64(ctx, val));
+    }
+
+    /**
+     * @brief 设置全局变量
+     *
+     * @param property_name 变量名
+     * @param handle        值, 句柄仍需调用方释放
+     * @return int
+     */
+    int quickjs_set_property_str(const char *property_name, QuickJSHandle_t handle)
+    {
+        JSValue value = from_handle(handle);
+        if (JS_IsException(value))
+        {
+            return -1;
+        }
+        JSValue global_obj = JS_GetGlobalObject(ctx);
+        int sps = JS_SetPropertyStr(ctx, global_obj, property_name, JS_DupValue(ctx, value));
+        JS_FreeValue(ctx, global_obj);
+        return sps;
+    }
+
+    /**
+     * @brief 释放句柄
+     *
+     * @param handle
+     * @return bool 句柄无效时返回false
+     */
+    bool quickjs_release(QuickJSHandle_t handle)
+    {
+        HandleSlot *slot = find_slot(handle);
+        if (!slot)
+        {
+            debug_invalid_handle("release", handle);
+            return false;
+        }
+        JSValue val = slot->value;
+        slot->live = false;
+        slot->value = JS_UNDEFINED;
+        free_slots.push_back((uint32_t)(handle & QUICKJS_HANDLE_INDEX_MASK) - 1);
+        live_handles--;
+        JS_FreeValue(ctx, val);
+        return true;
+    }
+
+    /**
+     * @brief 释放所有句柄
+     */
+    void quickjs_release_all()
+    {
+        for (uint32_t i = 0; i < slots.size(); i++)
+        {
+            if (slots[i].live)
+            {
+                quickjs_release(make_handle(i));
+            }
+        }
+    }
+
+    /**
+     * @brief 开关调试模式, 开启后记录无效句柄的使用, 释放运行时时报告未释放的句柄
+     *
+     * @param enable
+     */
+    void quickjs_set_debug(bool enable)
+    {
+        debug = enable;
+    }
+
+    /**
+     * @brief 获取存活的句柄数量
+     *
+     * @return int
+     */
+    int quickjs_handle_count() const
+    {
+        return (int)live_handles;
+    }
+
+    /**
+     * @brief 调试报告: 存活句柄及其引用计数, 无效句柄的使用次数
+     *
+     * @param buf 调用方缓冲区
+     * @param buf_len
+     * @return size_t 报告长度, 大于等于 buf_len 时说明被截断
+     */
+    size_t quickjs_debug_report(char *buf, size_t buf_len)
+    {
+        std::string report = "live_handles=" + std::to_string(live_handles) +
+                             " invalid_uses=" + std::to_string(invalid_uses) + "\n";
+        for (uint32_t i = 0; i < slots.size(); i++)
+        {
+            if (!slots[i].live)
+            {
+                continue;
+            }
+            JSValue val = slots[i].value;
+            char line[96];
+            if (JS_VALUE_HAS_REF_COUNT(val))
+            {
+                snprintf(line, sizeof(line), "handle=%lld tag=%d refcount=%d\n", (long long)make_handle(i),
+                         JS_VALUE_GET_TAG(val), ((JSRefCountHeader *)JS_VALUE_GET_PTR(val))->ref_count);
+            }
+            else
+            {
+                snprintf(line, sizeof(line), "handle=%lld tag=%d\n", (long long)make_handle(i), JS_VALUE_GET_TAG(val));
+            }
+            report += line;
+        }
+        return quickjs_copy_string(report.data(), report.size(), buf, buf_len);
+    }
+
+    /**
+     * @brief 编译js代码为字节码, 不执行
+     *
+     * @param js_code
+     * @param cache_dir 磁盘缓存目录, 为NULL或空字符串时只使用进程内缓存;
+     * 缓存文件等同于可执行代码, 目录须为当前用户所有且组和其他用户不可写 (建议0700), 否则不读写磁盘缓存
+     * @return QuickJSScript* 失败返回NULL, 异常可通过 quickjs_get_exception 获取
+     */
+    QuickJSScript *quickjs_compile(const char *js_code, const char *cache_dir)
+    {
+        size_t len = strlen(js_code);
+        uint64_t hash = quickjs_hash_source(js_code, len);
+        bool use_disk = cache_dir && cache_dir[0] && quickjs_cache_dir_trusted(cache_dir);
+
+        std::shared_ptr<const std::vector<uint8_t>> code = QuickJSScriptCache::instance().get(hash, js_code, len);
+        if (!code && use_disk)
+        {
+            code = quickjs_cache_load(cache_dir, hash, js_code, len);
+            if (code)
+            {
+                QuickJSScriptCache::instance().put(hash, js_code, len, code);
+            }
+        }
+        if (code)
+        {
+            return new QuickJSScript{hash, len, code};
+        }
+
+        uint64_t start = quickjs_now_us();
+        JSValue obj = JS_Eval(ctx, js_code, len, "quick.js", JS_EVAL_TYPE_GLOBAL | JS_EVAL_FLAG_COMPILE_ONLY);
+        counters.parse_us += quickjs_now_us() - start;
+        if (JS_IsException(obj))
+        {
+            return NULL;
+        }
+        size_t size;
+        uint8_t *buf = JS_WriteObject(ctx, &size, obj, JS_WRITE_OBJ_BYTECODE);
+        JS_FreeValue(ctx, obj);
+        if (!buf)
+        {
+            return NULL;
+        }
+        code = std::make_shared<const std::vector<uint8_t>>(buf, buf + size);
+        js_free(ctx, buf);
+
+        QuickJSScriptCache::instance().put(hash, js_code, len, code);
+        QuickJSScript *script = new QuickJSScript{hash, len, code};
+        if (use_disk)
+        {
+            quickjs_cache_store(cache_dir, script, js_code);
+        }
+        return script;
+    }
+
+    /**
+     * @brief 执行预编译的字节码
+     *
+     * 同一运行时内首次执行时反序列化字节码, 之后直接复用函数对象, 不再经过解析器
+     *
+     * @param script
+     * @return QuickJSHandle_t
+     */
+    QuickJSHandle_t quickjs_run_compiled(const QuickJSScript *script)
+    {
+        auto it = functions.find(script->hash);
+        if (it == functions.end() || it->second.code != script->code.get())
+        {
+            JSValue fun = JS_ReadObject(ctx, script->code->data(), script->code->size(), JS_READ_OBJ_BYTECODE);
+            if (JS_IsException(fun))
+            {
+                return to_handle(fun);
+            }
+            if (it != functions.end())
+            {
+                JS_FreeValue(ctx, it->second.fun);
+                functions.erase(it);
+            }
+            it = functions.emplace(script->hash, CompiledFunction{script->code.get(), fun}).first;
+        }
+        // JS_EvalFunction 会接管传入的引用
+        counters.evals++;
+        begin_eval();
+        JSValue val = JS_EvalFunction(ctx, JS_DupValue(ctx, it->second.fun));
+        end_eval();
+        return to_handle(val);
+    }
+
+    /**
+     * @brief 调用JS函数, this 为 undefined
+     *
+     * @param func 函数句柄
+     * @param argc
+     * @param argv 参数句柄
+     * @return QuickJSHandle_t
+     */
+    QuickJSHandle_t quickjs_call(QuickJSHandle_t func, int argc, const QuickJSHandle_t *argv)
+    {
+        JSValue fun = from_handle(func);
+        if (JS_IsException(fun))
+        {
+            return to_handle(JS_EXCEPTION);
+        }
+        // JS_Call 执行期间直接引用参数数组, 不能使用会被嵌套调用覆盖的成员缓冲区
+        JSValue stack_args[8];
+        std::vector<JSValue> heap_args;
+        JSValue *args = stack_args;
+        if (argc > 8)
+        {
+            heap_args.resize(argc);
+            args = heap_args.data();
+        }
+        for (int i = 0; i < argc; i++)
+        {
+            args[i] = from_handle(argv[i]);
+            if (JS_IsException(args[i]))
+            {
+                return to_handle(JS_EXCEPTION);
+            }
+        }
+        counters.evals++;
+        begin_eval();
+        JSValue val = JS_Call(ctx, fun, JS_UNDEFINED, argc, args);
+        end_eval();
+        return to_handle(val);
+    }
+
+    /**
+     * @brief 执行待执行的任务 (Promise 回调等) 和到期的定时器, 不会阻塞等待
+     *
+     * 先执行完所有任务再执行一个到期的定时器, 与浏览器中微任务/宏任务的顺序一致
+     *
+     * @param max_jobs 最多执行的个数, 0 为不限制
+     * @param max_us 最长执行时间 (微秒), 0 为不限制; 至少会执行一个
+     * @return int 执行的个数, 出现异常时返回-1, 异常可通过 quickjs_get_exception 获取
+     */
+    int quickjs_run_jobs(int max_jobs, uint64_t max_us)
+    {
+        uint64_t start = quickjs_now_us();
+        int count = 0;
+        begin_eval();
+        while (max_jobs <= 0 || count < max_jobs)
+        {
+            if (count && max_us && quickjs_now_us() - start >= max_us)
+            {
+                break;
+            }
+            int ret;
+            if (JS_IsJobPending(rt))
+            {
+                JSContext *job_ctx;
+                ret = JS_ExecutePendingJob(rt, &job_ctx);
+            }
+            else
+            {
+                ret = run_timer();
+            }
+            if (ret < 0)
+            {
+                count = -1;
+                break;
+            }
+            if (ret == 0)
+            {
+                break;
+            }
+            count++;
+            counters.jobs++;
+        }
+        end_eval();
+        return count;
+    }
+
+    /**
+     * @brief 查询是否还有待执行的工作
+     *
+     * @return int64_t -1 为没有, 0 为有可以立即执行的任务, 大于0为距下一个定时器到期的微秒数
+     */
+    int64_t quickjs_pending()
+    {
+        if (JS_IsJobPending(rt))
+        {
+            return 0;
+        }
+        if (timers.empty())
+        {
+            return -1;
+        }
+        uint64_t now = quickjs_now_us();
+        uint64_t deadline = timers[next_timer()].deadline;
+        return deadline > now ? (int64_t)(deadline - now) : 0;
+    }
+
+    /**
+     * @brief 获取 Promise 的状态
+     *
+     * @param handle
+     * @return int -1 不是 Promise, 0 等待中, 1 已完成, 2 已拒绝
+     */
+    int quickjs_promise_state(QuickJSHandle_t handle)
+    {
+        JSValue val = from_handle(handle);
+        if (JS_IsException(val))
+        {
+            return -1;
+        }
+        return (int)JS_PromiseState(ctx, val);
+    }
+
+    /**
+     * @brief 等待 Promise 完成, 期间执行任务和定时器, 没有可执行的任务时休眠到下一个定时器到期
+     *
+     * @param handle
+     * @param max_us 最长等待时间 (微秒), 0 为不限制
+     * @return QuickJSHandle_t 完成时为结果; 拒绝时为异常, 异常信息为拒绝原因; 不是 Promise 时为值本身
+     */
+    QuickJSHandle_t quickjs_await(QuickJSHandle_t handle, uint64_t max_us)
+    {
+        JSValue val = from_handle(handle);
+        if (JS_IsException(val))
+        {
+            return to_handle(JS_EXCEPTION);
+        }
+        uint64_t start = quickjs_now_us();
+        for (;;)
+        {
+            switch ((int)JS_PromiseState(ctx, val))
+            {
+            case JS_PROMISE_PENDING:
+                break;
+            case JS_PROMISE_FULFILLED:
+                return to_handle(JS_PromiseResult(ctx, val));
+            case JS_PROMISE_REJECTED:
+                return to_handle(JS_Throw(ctx, JS_PromiseResult(ctx, val)));
+            default:
+                return to_handle(JS_DupValue(ctx, val));
+            }
+
+            uint64_t elapsed = quickjs_now_us() - start;
+            if (max_us && elapsed >= max_us)
+            {
+                return to_handle(JS_ThrowInternalError(ctx, "await timed out"));
+            }
+            int64_t wait = quickjs_pending();
+            if (wait < 0)
+            {
+                return to_handle(JS_ThrowInternalError(ctx, "promise will never settle"));
+            }
+            if (wait > 0)
+            {
+                if (max_us && (uint64_t)wait > max_us - elapsed)
+                {
+                    wait = (int64_t)(max_us - elapsed);
+                }
+                std::this_thread::sleep_for(std::chrono::microseconds(wait));
+                continue;
+            }
+            if (quickjs_run_jobs(0, max_us ? max_us - elapsed : 0) < 0)
+            {
+                return to_handle(JS_EXCEPTION);
+            }
+        }
+    }
+
+    /**
+     * @brief 重置运行时, 恢复到刚创建时的全局对象和内置对象
+     *
+     * 释放所有句柄, 删除用户定义的全局变量, 还原被覆盖或删除的内置全局属性, 清除定时器和未处理的异常并执行GC;
+     * 调用过 quickjs_track_builtins 的运行时 (运行时池创建的运行时) 还会还原内置构造函数、原型对象等的属性和原型。
+     * 内存上限、栈深度、GC阈值、超时和内存统计还原为默认值, 宿主回调被清除, 复用时需重新设置;
+     * 已加载的预编译字节码保留, 下次执行无需再次反序列化; 尚未执行的 Promise 任务无法丢弃, 此时返回false, 运行时不应再复用。
+     * 注意: 全局 var/function 声明不可删除, 只会被置为 undefined;
+     * 顶层 let/const 声明无法通过公开API清除, 需要隔离的脚本应避免使用。
+     *
+     * @return bool 内置对象被冻结、添加了不可删除的属性、有未执行的 Promise 任务等无法还原时返回false, 运行时不应再复用
+     */
+    bool quickjs_reset()
+    {
+        quickjs_release_all();
+        last_error.clear();
+        restore_limits();
+        // 宿主回调可能在下一个使用者之前失效 (例如 PHP 请求结束时释放的闭包)
+        host_callback = NULL;
+
+        bool clean = true;
+        for (size_t i = 0; i < baseline.size(); i++)
+        {
+            // 全局对象上不可删除的 var/function 声明置为 undefined 即可, 不影响复用
+            clean = restore_baseline(baseline[i], i == 0) && clean;
+        }
+
+        clear_timers();
+        JS_FreeValue(ctx, JS_GetException(ctx));
+        JS_RunGC(rt);
+        resets++;
+        // 排队的 Promise 任务会在下一个使用者的 quickjs_run_jobs 中执行
+        return clean && !JS_IsJobPending(rt);
+    }
+
+    /**
+     * @brief 获取重置次数
+     *
+     * @return unsigned
+     */
+    unsigned quickjs_reset_count() const
+    {
+        return resets;
+    }
+
+    /**
+     * @brief 记录从全局对象可达的内置对象 (构造函数、原型、命名空间对象), 之后 quickjs_reset 也会还原它们
+     *
+     * 须在执行任何脚本之前调用, 运行时池创建的运行时会自动调用。
+     * 沿属性值和原型链遍历; 迭代器、生成器等只能从实例取得的内部原型另外加入。
+     * 内置方法自身的属性不记录, 方法作为属性值被替换或删除时仍会还原。
+     * 记录时会实例化所有延迟创建的内置方法, 创建耗时和内存约增加一倍, 因此单独创建的运行时默认不记录。
+     */
+    void quickjs_track_builtins()
+    {
+        if (baseline.size() > 1)
+        {
+            return;
+        }
+        std::unordered_set<void *> seen{JS_VALUE_GET_PTR(baseline[0].obj)};
+        std::vector<JSValue> queue;
+        auto visit = [&](JSValue val)
+        {
+            if (JS_IsObject(val) && (!JS_IsFunction(ctx, val) || JS_IsConstructor(ctx, val)) &&
+                seen.insert(JS_VALUE_GET_PTR(val)).second)
+            {
+                queue.push_back(JS_DupValue(ctx, val));
+            }
+        };
+
+        static const char intrinsics_js[] =
+            "[Object.getPrototypeOf([][Symbol.iterator]()), Object.getPrototypeOf(''[Symbol.iterator]()),"
+            " Object.getPrototypeOf(new Map().entries()), Object.getPrototypeOf(new Set().values()),"
+            " Object.getPrototypeOf(/a/[Symbol.matchAll]('')), Object.getPrototypeOf(function* () {}),"
+            " Object.getPrototypeOf(async function () {}), Object.getPrototypeOf(async function* () {})]";
+        JSValue intrinsics = JS_Eval(ctx, intrinsics_js, sizeof(intrinsics_js) - 1, "<baseline>", JS_EVAL_TYPE_GLOBAL);
+        for (uint32_t i = 0; JS_IsObject(intrinsics) && i < 8; i++)
+        {
+            JSValue val = JS_GetPropertyUint32(ctx, intrinsics, i);
+            visit(val);
+            JS_FreeValue(ctx, val);
+        }
+        JS_FreeValue(ctx, intrinsics);
+        JS_FreeValue(ctx, JS_GetException(ctx));
+
+        auto visit_props = [&](const BaselineObject &object)
+        {
+            visit(object.proto);
+            for (auto &prop : object.props)
+            {
+                visit(prop.value);
+            }
+        };
+        visit_props(baseline[0]);
+        for (size_t n = 0; n < queue.size(); n++)
+        {
+            baseline.push_back(snapshot_object(queue[n]));
+            visit_props(baseline.back());
+        }
+    }
+
+    /**
+     * @brief 创建类型化数组
+     *
+     * @param data 数据
+     * @param count 元素个数
+     * @param type QUICKJS_MARSHAL_UINT8_ARRAY/INT32_ARRAY/FLOAT64_ARRAY
+     * @param copy 为false时直接引用 data 不拷贝, 调用方需保证JS对象存活期间 data 有效
+     * @return QuickJSHandle_t
+     */
+    QuickJSHandle_t quickjs_new_typed_array(void *data, size_t count, int type, bool copy)
+    {
+        size_t size = quickjs_marshal_element_size(type);
+        if (!size)
+        {
+            return to_handle(JS_ThrowTypeError(ctx, "unsupported typed array type %d", type));
+        }
+        if (count > SIZE_MAX / size)
+        {
+            return to_handle(JS_ThrowRangeError(ctx, "typed array length %zu too large", count));
+        }
+        JSValue buffer = copy ? JS_NewArrayBufferCopy(ctx, (const uint8_t *)data, count * size)
+                              : JS_NewArrayBuffer(ctx, (uint8_t *)data, count * size, NULL, NULL, 0);
+        return to_handle(new_typed_array(buffer, type));
+    }
+
+    /**
+     * @brief 从二进制缓冲区创建JS值
+     *
+     * @param buf 结构化数据二进制格式
+     * @param len
+     * @return QuickJSHandle_t 格式错误时为异常
+     */
+    QuickJSHandle_t quickjs_new_from_buffer(const char *buf, size_t len)
+    {
+        MarshalReader reader{(const uint8_t *)buf, (const uint8_t *)buf, (const uint8_t *)buf + len};
+        JSValue val = read_value(reader, 0);
+        if (!JS_IsException(val) && reader.pos != reader.end)
+        {
+            JS_FreeValue(ctx, val);
+            val = JS_ThrowTypeError(ctx, "marshal: trailing data");
+        }
+        return to_handle(val);
+    }
+
+    /**
+     * @brief 将JS值写入二进制缓冲区
+     *
+     * 函数和 symbol 写为 undefined, 其他对象只写自身可枚举的字符串键
+     *
+     * @param handle
+     * @param len 输出长度
+     * @return const uint8_t* 缓冲区归运行时所有, 下次调用前有效; 失败返回NULL
+     */
+    const uint8_t *quickjs_to_buffer(QuickJSHandle_t handle, size_t *len)
+    {
+        JSValue val = from_handle(handle);
+        if (JS_IsException(val))
+        {
+            return NULL;
+        }
+        return write_buffer(val, len);
+    }
+
+    /**
+     * @brief 执行js代码并将结果写入二进制缓冲区, 结果不登记句柄
+     *
+     * @param js_code
+     * @param len 输出长度
+     * @return const uint8_t* 同 quickjs_to_buffer, 执行异常时返回NULL
+     */
+    const uint8_t *quickjs_eval_to_buffer(const char *js_code, size_t *len)
+    {
+        // 执行和写入共用一次超时
+        begin_eval();
+        JSValue val = eval_code(js_code);
+        const uint8_t *buf = JS_IsException(val) ? NULL : write_buffer(val, len);
+        JS_FreeValue(ctx, val);
+        end_eval();
+        return buf;
+    }
+
+    /**
+     * @brief 获取专用分配器统计
+     *
+     * @param stats
+     * @return bool 未使用专用分配器时返回false
+     */
+    bool quickjs_alloc_stats(QuickJSAllocStats *stats) const
+    {
+        if (!arena)
+        {
+            return false;
+        }
+        *stats = arena->get_stats();
+        return true;
+    }
+
+    /**
+     * @brief 设置内存上限, 超出时分配失败并抛出 out of memory
+     *
+     * @param limit 字节数, 0 为不限制
+     */
+    void quickjs_set_memory_limit(size_t limit)
+    {
+        memory_limit = limit;
+        JS_SetMemoryLimit(rt, limit ? limit : (size_t)-1);
+    }
+
+    /**
+     * @brief 设置最大栈深度, 超出时抛出 stack overflow
+     *
+     * @param stack_size 字节数, 0 为不检查
+     */
+    void quickjs_set_max_stack_size(size_t stack_size)
+    {
+        JS_SetMaxStackSize(rt, stack_size);
+    }
+
+    /**
+     * @brief 设置自动GC阈值
+     *
+     * @param gc_threshold 已分配字节超过该值时触发GC, (size_t)-1 为关闭自动GC
+     */
+    void quickjs_set_gc_threshold(size_t gc_threshold)
+    {
+        gc_threshold_set = true;
+        JS_SetGCThreshold(rt, gc_threshold);
+    }
+
+    /**
+     * @brief 设置单次执行的超时时间, 超时后抛出不可捕获的 interrupted 异常
+     *
+     * @param timeout_us 微秒, 0 为不限制
+     * @param check_interval 每多少次中断回调检查一次时钟, 0 视为1
+     */
+    void quickjs_set_timeout(uint64_t timeout_us, uint32_t check_interval)
+    {
+        this->timeout_us = timeout_us;
+        this->check_interval = check_interval ? check_interval : 1;
+        JS_SetInterruptHandler(rt, timeout_us ? interrupt_handler : NULL, this);
+    }
+
+    /**
+     * @brief 开关内存统计, 开启后每次执行前后调用 JS_ComputeMemoryUsage, 开销随堆大小增长
+     *
+     * @param enable
+     */
+    void quickjs_set_usage_tracking(bool enable)
+    {
+        track_usage = enable;
+    }
+
+    /**
+     * @brief 获取最近一次执行的资源使用
+     *
+     * @param usage
+     */
+    void quickjs_last_usage(QuickJSEvalUsage *usage) const
+    {
+        *usage = last_usage;
+    }
+
+    /**
+     * @brief 获取累计计数
+     *
+     * @param out
+     */
+    void quickjs_get_counters(QuickJSCounters *out) const
+    {
+        *out = counters;
+        out->allocations = arena ? arena->get_stats().alloc_count - arena_allocations : alloc_counter.allocations;
+    }
+
+    /**
+     * @brief 清零累计计数
+     */
+    void quickjs_reset_counters()
+    {
+        counters = QuickJSCounters{};
+        alloc_counter.allocations = 0;
+        if (arena)
+        {
+            arena_allocations = arena->get_stats().alloc_count;
+        }
+    }
+
+    /**
+     * @brief 执行GC
+     */
+    void quickjs_run_gc()
+    {
+        JS_RunGC(rt);
+    }
+
+private:
+    // 定时器, 与 quickjs-libc 的 os.setTimeout 一样只支持函数和延迟两个参数
+    struct Timer
+    {
+        int64_t id;
+        uint64_t deadline; // 到期时间 (微秒, 单调时钟)
+        JSValue func;
+    };
+
+    /**
+     * @brief 添加全局的 setTimeout/clearTimeout, 由 quickjs_run_jobs 驱动
+     */
+    void install_timers()
+    {
+        JSValue global_obj = JS_GetGlobalObject(ctx);
+        JS_SetPropertyStr(ctx, global_obj, "setTimeout", JS_NewCFunction(ctx, set_timeout, "setTimeout", 2));
+        JS_SetPropertyStr(ctx, global_obj, "clearTimeout", JS_NewCFunction(ctx, clear_timeout, "clearTimeout", 1));
+        JS_FreeValue(ctx, global_obj);
+    }
+
+    static JSValue set_timeout(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv)
+    {
+        QuickJS *quickjs = (QuickJS *)JS_GetContextOpaque(ctx);
+        double delay;
+        if (!JS_IsFunction(ctx, argv[0]))
+        {
+            return JS_ThrowTypeError(ctx, "not a function");
+        }
+        if (JS_ToFloat64(ctx, &delay, argv[1]))
+        {
+            return JS_EXCEPTION;
+        }
+        // 超过 2^31-1 毫秒 (约24.8天, 含 Infinity) 按最大值计算, 避免换算为微秒时溢出; NaN 和负数为0
+        if (delay > INT32_MAX)
+        {
+            delay = INT32_MAX;
+        }
+        Timer timer = {quickjs->next_timer_id++, quickjs_now_us() + (delay > 0 ? (uint64_t)delay * 1000 : 0), JS_DupValue(ctx, argv[0])};
+        quickjs->timers.push_back(timer);
+        return JS_NewInt64(ctx, timer.id);
+    }
+
+    static JSValue clear_timeout(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv)
+    {
+        QuickJS *quickjs = (QuickJS *)JS_GetContextOpaque(ctx);
+        int64_t id;
+        if (JS_ToInt64(ctx, &id, argv[0]))
+        {
+            return JS_EXCEPTION;
+        }
+        for (size_t i = 0; i < quickjs->timers.size(); i++)
+        {
+            if (quickjs->timers[i].id == id)
+            {
+                JS_FreeValue(ctx, quickjs->timers[i].func);
+                quickjs->timers.erase(quickjs->timers.begin() + i);
+                break;
+            }
+        }
+        return JS_UNDEFINED;
+    }
+
+    /**
+     * @brief 最早到期的定时器, timers 不能为空
+     *
+     * @return size_t
+     */
+    size_t next_timer() const
+    {
+        size_t next = 0;
+        for (size_t i = 1; i < timers.size(); i++)
+        {
+            if (timers[i].deadline < timers[next].deadline)
+            {
+                next = i;
+            }
+        }
+        return next;
+    }
+
+    /**
+     * @brief 执行一个到期的定时器
+     *
+     * @return int 1 已执行, 0 没有到期的定时器, -1 异常
+     */
+    int run_timer()
+    {
+        if (timers.empty())
+        {
+            return 0;
+        }
+        size_t next = next_timer();
+        if (timers[next].deadline > quickjs_now_us())
+        {
+            return 0;
+        }
+        // 先移除再调用, 回调中可以再添加或清除定时器
+        JSValue func = timers[next].func;
+        timers.erase(timers.begin() + next);
+        JSValue ret = JS_Call(ctx, func, JS_UNDEFINED, 0, NULL);
+        JS_FreeValue(ctx, func);
+        if (JS_IsException(ret))
+        {
+            return -1;
+        }
+        JS_FreeValue(ctx, ret);
+        return 1;
+    }
+
+    /**
+     * @brief 清除所有定时器
+     */
+    void clear_timers()
+    {
+        for (Timer &timer : timers)
+        {
+            JS_FreeValue(ctx, timer.func);
+        }
+        timers.clear();
+    }
+
+    /**
+     * @brief 宿主函数的C入口
+     *
+     * @param ctx
+     * @param this_val
+     * @param argc
+     * @param argv
+     * @param magic
+     * @param func_data func_data[0] 为 function_id
+     * @return JSValue
+     */
+    static JSValue host_trampoline(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv, int magic, JSValue *func_data)
+    {
+        return ((QuickJS *)JS_GetContextOpaque(ctx))->call_host(JS_VALUE_GET_INT(func_data[0]), argc, argv);
+    }
+
+    /**
+     * @brief 调用宿主函数
+     *
+     * 每层调用深度复用一个参数数组, 嵌套调用 (回调中再执行JS) 不会覆盖外层的参数
+     *
+     * @param function_id
+     * @param argc
+     * @param argv
+     * @return JSValue
+     */
+    JSValue call_host(int32_t function_id, int argc, JSValueConst *argv)
+    {
+        if (!host_callback)
+        {
+            return JS_ThrowReferenceError(ctx, "host callback is not set");
+        }
+        size_t depth = host_depth;
+        if (depth == host_argv.size())
+        {
+            host_argv.emplace_back();
+        }
+        if (host_argv[depth].size() < (size_t)argc)
+        {
+            host_argv[depth].resize(argc);
+        }
+        // 外层数组可能因嵌套调用而扩容, 但各层参数数组的存储不会移动
+        QuickJSHandle_t *args = host_argv[depth].data();
+        for (int i = 0; i < argc; i++)
+        {
+            args[i] = to_handle(JS_DupValue(ctx, argv[i]));
+        }
+
+        counters.host_calls++;
+        host_error_set = false;
+        host_depth++;
+        QuickJSHandle_t ret = host_callback(this, function_id, argc, args);
+        host_depth--;
+
+        // 回调可能直接返回参数句柄, 先取出返回值再释放参数
+        JSValue val = JS_UNDEFINED;
+        bool ret_invalid = false;
+        if (ret)
+        {
+            HandleSlot *slot = find_slot(ret);
+            if (!slot)
+            {
+                debug_invalid_handle("return", ret);
+                ret_invalid = true;
+            }
+            else
+            {
+                if (!host_error_set)
+                {
+                    val = JS_DupValue(ctx, slot->value);
+                }
+                quickjs_release(ret);
+            }
+        }
+        for (int i = 0; i < argc; i++)
+        {
+            if (args[i] != ret)
+            {
+                quickjs_release(args[i]);
+            }
+        }
+        if (host_error_set)
+        {
+            host_error_set = false;
+            JSValue error = JS_NewError(ctx);
+            JS_DefinePropertyValueStr(ctx, error, "message", JS_NewStringLen(ctx, host_error.data(), host_error.size()),
+                                      JS_PROP_WRITABLE | JS_PROP_CONFIGURABLE);
+            return JS_Throw(ctx, error);
+        }
+        if (ret_invalid)
+        {
+            return JS_ThrowTypeError(ctx, "invalid handle %lld", (long long)ret);
+        }
+        if (JS_IsException(val))
+        {
+            // 返回了执行异常的句柄, 异常可能已被 quickjs_get_exception 取走
+            JSValue error = JS_GetException(ctx);
+            if (JS_IsNull(error))
+            {
+                return JS_ThrowInternalError(ctx, "%s", last_error.empty() ? "host function failed" : last_error.c_str());
+            }
+            return JS_Throw(ctx, error);
+        }
+        return val;
+    }
+
+    /**
+     * @brief 中断回调, 每 check_interval 次检查一次是否超过截止时间
+     *
+     * @param rt
+     * @param opaque
+     * @return int 非0时中断执行
+     */
+    static int interrupt_handler(JSRuntime *rt, void *opaque)
+    {
+        QuickJS *quickjs = (QuickJS *)opaque;
+        if (!quickjs->deadline || ++quickjs->ticks < quickjs->check_interval)
+        {
+            return 0;
+        }
+        quickjs->ticks = 0;
+        if (quickjs_now_us() < quickjs->deadline)
+        {
+            return 0;
+        }
+        quickjs->interrupted = true;
+        return 1;
+    }
+
+    /**
+     * @brief 分开解析和执行全局代码, 与 JS_Eval 的结果相同, 分别计入解析和执行耗时
+     *
+     * @param js_code
+     * @return JSValue
+     */
+    JSValue eval_code(const char *js_code)
+    {
+        counters.evals++;
+        uint64_t start = quickjs_now_us();
+        JSValue fun = JS_Eval(ctx, js_code, strlen(js_code), "quick.js", JS_EVAL_TYPE_GLOBAL | JS_EVAL_FLAG_COMPILE_ONLY);
+        eval_parse_us += quickjs_now_us() - start;
+        if (JS_IsException(fun))
+        {
+            return fun;
+        }
+        return JS_EvalFunction(ctx, fun);
+    }
+
+    /**
+     * @brief 创建GC哨兵对象
+     *
+     * QuickJS 没有GC回调, 哨兵对象由本类持有而始终存活, 每次GC (包括自动触发的) 在
+     * gc_decref 阶段对所有对象调用一次 gc_mark, 以此计数; 之后的阶段使用不同的 mark_func, 不计入
+     */
+    void install_gc_sentinel()
+    {
+        // JS_NewClassID 修改全局计数器, 批量执行时多个线程会同时创建运行时
+        static std::once_flag once;
+        std::call_once(once, []()
+                       { JS_NewClassID(&gc_sentinel_class_id); });
+        JSClassDef def = {};
+        def.class_name = "QuickJSGCSentinel";
+        def.gc_mark = gc_sentinel_mark;
+        JS_NewClass(rt, gc_sentinel_class_id, &def);
+        gc_sentinel = JS_NewObjectClass(ctx, gc_sentinel_class_id);
+        JS_SetOpaque(gc_sentinel, this);
+    }
+
+    static void gc_sentinel_mark(JSRuntime *rt, JSValueConst val, JS_MarkFunc *mark_func)
+    {
+        QuickJS *quickjs = (QuickJS *)JS_GetOpaque(val, gc_sentinel_class_id);
+        if (!quickjs)
+        {
+            return;
+        }
+        // 第一次调用一定来自第一次GC的 gc_decref 阶段
+        if (!quickjs->gc_decref_func)
+        {
+            quickjs->gc_decref_func = mark_func;
+        }
+        if (mark_func == quickjs->gc_decref_func)
+        {
+            quickjs->counters.gc_runs++;
+        }
+    }
+
+    /**
+     * @brief 超出内存上限被拒绝的累计分配次数
+     *
+     * @return uint64_t
+     */
+    uint64_t limit_hits() const
+    {
+        return arena ? arena->limit_hits : alloc_counter.limit_hits;
+    }
+
+    /**
+     * @brief 还原内存上限、栈深度、GC阈值、超时和内存统计为新建运行时的默认值
+     */
+    void restore_limits()
+    {
+        quickjs_set_memory_limit(0);
+        JS_SetMaxStackSize(rt, JS_DEFAULT_STACK_SIZE);
+        if (gc_threshold_set)
+        {
+            gc_threshold_set = false;
+            JS_SetGCThreshold(rt, QUICKJS_DEFAULT_GC_THRESHOLD);
+        }
+        quickjs_set_timeout(0, 0);
+        track_usage = false;
+    }
+
+    /**
+     * @brief 开始计量一次执行, 嵌套调用时只计量最外层
+     */
+    void begin_eval()
+    {
+        if (eval_depth++)
+        {
+            return;
+        }
+        // 运行时可能在其他栈上创建 (运行时池), 以当前栈为栈顶计算栈深度
+        JS_UpdateStackTop(rt);
+        interrupted = false;
+        // 上一次执行未取走的异常和异常信息不再有效
+        JS_FreeValue(ctx, JS_GetException(ctx));
+        last_error.clear();
+        eval_limit_hits = limit_hits();
+        ticks = 0;
+        if (track_usage)
+        {
+            JSMemoryUsage mu;
+            JS_ComputeMemoryUsage(rt, &mu);
+            eval_malloc_size = mu.malloc_size;
+        }
+        eval_parse_us = 0;
+        eval_start = quickjs_now_us();
+        deadline = timeout_us ? eval_start + timeout_us : 0;
+    }
+
+    /**
+     * @brief 结束计量, 记录资源使用
+     */
+    void end_eval()
+    {
+        if (--eval_depth)
+        {
+            return;
+        }
+        deadline = 0;
+        last_usage.elapsed_us = quickjs_now_us() - eval_start;
+        last_usage.interrupted = interrupted;
+        counters.parse_us += eval_parse_us;
+        counters.execute_us += last_usage.elapsed_us - (eval_parse_us < last_usage.elapsed_us ? eval_parse_us : last_usage.elapsed_us);
+        if (track_usage)
+        {
+            JSMemoryUsage mu;
+            JS_ComputeMemoryUsage(rt, &mu);
+            last_usage.malloc_size = mu.malloc_size;
+            last_usage.malloc_delta = mu.malloc_size - eval_malloc_size;
+            last_usage.malloc_count = mu.malloc_count;
+            last_usage.memory_used_size = mu.memory_used_size;
+        }
+        else
+        {
+            last_usage.malloc_size = last_usage.malloc_delta = last_usage.malloc_count = last_usage.memory_used_size = -1;
+        }
+    }
+
+    struct HandleSlot
+    {
+        JSValue value;
+        uint64_t generation;
+        bool live;
+    };
+
+    QuickJSHandle_t make_handle(uint32_t index) const
+    {
+        return (QuickJSHandle_t)((slots[index].generation << QUICKJS_HANDLE_INDEX_BITS) | (index + 1));
+    }
+
+    HandleSlot *find_slot(QuickJSHandle_t handle)
+    {
+        uint32_t index = (uint32_t)(handle & QUICKJS_HANDLE_INDEX_MASK);
+        if (handle <= 0 || index == 0 || index > slots.size())
+        {
+            return NULL;
+        }
+        HandleSlot *slot = &slots[index - 1];
+        if (!slot->live || slot->generation != ((uint64_t)handle >> QUICKJS_HANDLE_INDEX_BITS))
+        {
+            return NULL;
+        }
+        return slot;
+    }
+
+    /**
+     * @brief 登记句柄, 接管 val 的引用
+     *
+     * @param val
+     * @return QuickJSHandle_t 句柄表已满时返回0
+     */
+    QuickJSHandle_t to_handle(JSValue val)
+    {
+        uint32_t index;
+        // 空闲槽位不多时优先新增槽位, 拉长同一槽位两次复用的间隔
+        if (free_slots.size() > QUICKJS_HANDLE_QUARANTINE || (!free_slots.empty() && slots.size() >= QUICKJS_HANDLE_INDEX_MASK))
+        {
+            index = free_slots.front();
+            free_slots.pop_front();
+            slots[index].generation = (slots[index].generation + 1) & QUICKJS_HANDLE_GENERATION_MASK;
+        }
+        else if (slots.size() < QUICKJS_HANDLE_INDEX_MASK)
+        {
+            index = (uint32_t)slots.size();
+            slots.push_back(HandleSlot{JS_UNDEFINED, 0, false});
+        }
+        else
+        {
+            JS_FreeValue(ctx, val);
+            return 0;
+        }
+        slots[index].value = val;
+        slots[index].live = true;
+        live_handles++;
+        return make_handle(index);
+    }
+
+    /**
+     * @brief 取句柄对应的值 (不增加引用), 句柄无效时返回异常
+     *
+     * 无效句柄不向运行时抛出异常, 以免残留到之后的执行中; 错误信息记录在 last_error, 由 quickjs_get_exception 返回
+     *
+     * @param handle
+     * @return JSValue
+     */
+    JSValue from_handle(QuickJSHandle_t handle)
+    {
+        HandleSlot *slot = find_slot(handle);
+        if (!slot)
+        {
+            debug_invalid_handle("use", handle);
+            last_error = "TypeError: invalid handle " + std::to_string((long long)handle);
+            return JS_EXCEPTION;
+        }
+        return slot->value;
+    }
+
+    void debug_invalid_handle(const char *op, QuickJSHandle_t handle)
+    {
+        invalid_uses++;
+        if (debug)
+        {
+            fprintf(stderr, "QuickJs: %s of invalid handle %lld\n", op, (long long)handle);
+        }
+    }
+
+    /**
+     * @brief 将JS值写入二进制缓冲区
+     *
+     * 输出不超过内存上限 (未设置时为 QUICKJS_MARSHAL_MAX_SIZE), 并受单次执行超时限制;
+     * 超出或内存不足时抛出JS异常并返回NULL
+     *
+     * @param val 不会释放
+     * @param len
+     * @return const uint8_t*
+     */
+    const uint8_t *write_buffer(JSValue val, size_t *len)
+    {
+        marshal_buf.clear();
+        marshal_limit = memory_limit ? memory_limit : QUICKJS_MARSHAL_MAX_SIZE;
+        // 在执行中 (quickjs_eval_to_buffer) 时沿用执行的截止时间
+        marshal_deadline = eval_depth ? deadline : (timeout_us ? quickjs_now_us() + timeout_us : 0);
+        marshal_ticks = 0;
+        JSValue global_obj = JS_GetGlobalObject(ctx);
+        for (int i = 0; i < 3; i++)
+        {
+            typed_array_ctors[i] = JS_GetPropertyStr(ctx, global_obj, quickjs_marshal_typed_array_name(typed_array_types[i]));
+        }
+        JS_FreeValue(ctx, global_obj);
+        bool ok;
+        try
+        {
+            ok = write_value(val, 0);
+        }
+        catch (const std::bad_alloc &)
+        {
+            JS_ThrowOutOfMemory(ctx);
+            ok = false;
+        }
+        for (int i = 0; i < 3; i++)
+        {
+            JS_FreeValue(ctx, typed_array_ctors[i]);
+        }
+        if (!ok)
+        {
+            // 归还写到一半的大缓冲区
+            std::vector<uint8_t>().swap(marshal_buf);
+            return NULL;
+        }
+        *len = marshal_buf.size();
+        return marshal_buf.data();
+    }
+
+    struct MarshalReader
+    {
+        const uint8_t *start;
+        const uint8_t *pos;
+        const uint8_t *end;
+    };
+
+    /**
+     * @brief 用 ArrayBuffer 创建类型化数组, 接管 buffer 的引用
+     *
+     * @param buffer
+     * @param type
+     * @return JSValue
+     */
+    JSValue new_typed_array(JSValue buffer, int type)
+    {
+        if (JS_IsException(buffer))
+        {
+            return buffer;
+        }
+        JSValue global_obj = JS_GetGlobalObject(ctx);
+        JSValue ctor = JS_GetPropertyStr(ctx, global_obj, quickjs_marshal_typed_array_name(type));
+        JSValue val = JS_CallConstructor(ctx, ctor, 1, &buffer);
+        JS_FreeValue(ctx, ctor);
+        JS_FreeValue(ctx, global_obj);
+        JS_FreeValue(ctx, buffer);
+        return val;
+    }
+
+    static bool read_bytes(MarshalReader &reader, void *out, size_t size)
+    {
+        if ((size_t)(reader.end - reader.pos) < size)
+        {
+            return false;
+        }
+        memcpy(out, reader.pos, size);
+        reader.pos += size;
+        return true;
+    }
+
+    JSValue read_value(MarshalReader &reader, int depth)
+    {
+        uint8_t type;
+        if (depth > QUICKJS_MARSHAL_MAX_DEPTH || !read_bytes(reader, &type, 1))
+        {
+            return JS_ThrowTypeError(ctx, "marshal: invalid buffer");
+        }
+        switch (type)
+        {
+        case QUICKJS_MARSHAL_UNDEFINED:
+            return JS_UNDEFINED;
+        case QUICKJS_MARSHAL_NULL:
+            return JS_NULL;
+        case QUICKJS_MARSHAL_FALSE:
+            return JS_FALSE;
+        case QUICKJS_MARSHAL_TRUE:
+            return JS_TRUE;
+        case QUICKJS_MARSHAL_INT:
+        {
+            int32_t v;
+            if (read_bytes(reader, &v, sizeof(v)))
+            {
+                return JS_NewInt32(ctx, v);
+            }
+            break;
+        }
+        case QUICKJS_MARSHAL_DOUBLE:
+        {
+            double v;
+            if (read_bytes(reader, &v, sizeof(v)))
+            {
+                return JS_NewFloat64(ctx, v);
+            }
+            break;
+        }
+        case QUICKJS_MARSHAL_STRING:
+        {
+            uint32_t n;
+            if (read_bytes(reader, &n, sizeof(n)) && (size_t)(reader.end - reader.pos) >= n)
+            {
+                JSValue str = JS_NewStringLen(ctx, (const char *)reader.pos, n);
+                reader.pos += n;
+                return str;
+            }
+            break;
+        }
+        case QUICKJS_MARSHAL_ARRAY:
+        {
+            uint32_t n;
+            if (!read_bytes(reader, &n, sizeof(n)))
+            {
+                break;
+            }
+            JSValue arr = JS_NewArray(ctx);
+            for (uint32_t i = 0; i < n && !JS_IsException(arr); i++)
+            {
+                JSValue item = read_value(reader, depth + 1);
+                if (JS_IsException(item) || JS_SetPropertyUint32(ctx, arr, i, item) < 0)
+                {
+                    JS_FreeValue(ctx, arr);
+                    arr = JS_EXCEPTION;
+                }
+            }
+            return arr;
+        }
+        case QUICKJS_MARSHAL_OBJECT:
+        {
+            uint32_t n;
+            if (!read_bytes(reader, &n, sizeof(n)))
+            {
+                break;
+            }
+            JSValue obj = JS_NewObject(ctx);
+            for (uint32_t i = 0; i < n && !JS_IsException(obj); i++)
+            {
+                uint32_t key_len;
+                if (!read_bytes(reader, &key_len, sizeof(key_len)) || (size_t)(reader.end - reader.pos) < key_len)
+                {
+                    JS_FreeValue(ctx, obj);
+                    return JS_ThrowTypeError(ctx, "marshal: invalid buffer");
+                }
+                JSAtom key = JS_NewAtomLen(ctx, (const char *)reader.pos, key_len);
+                reader.pos += key_len;
+                JSValue item = read_value(reader, depth + 1);
+                if (key == JS_ATOM_NULL || JS_IsException(item) ||
+                    JS_DefinePropertyValue(ctx, obj, key, item, JS_PROP_C_W_E) < 0)
+                {
+                    if (key == JS_ATOM_NULL)
+                    {
+                        JS_FreeValue(ctx, item);
+                    }
+                    JS_FreeValue(ctx, obj);
+                    obj = JS_EXCEPTION;
+                }
+                JS_FreeAtom(ctx, key);
+            }
+            return obj;
+        }
+        case QUICKJS_MARSHAL_UINT8_ARRAY:
+        case QUICKJS_MARSHAL_INT32_ARRAY:
+        case QUICKJS_MARSHAL_FLOAT64_ARRAY:
+        {
+            size_t size = quickjs_marshal_element_size(type);
+            uint32_t n;
+            if (!read_bytes(reader, &n, sizeof(n)))
+            {
+                break;
+            }
+            reader.pos = reader.start + ((reader.pos - reader.start + size - 1) / size) * size;
+            if (reader.pos > reader.end || (size_t)(reader.end - reader.pos) / size < n)
+            {
+                break;
+            }
+            JSValue buffer = JS_NewArrayBufferCopy(ctx, reader.pos, (size_t)n * size);
+            reader.pos += (size_t)n * size;
+            return new_typed_array(buffer, type);
+        }
+        }
+        return JS_ThrowTypeError(ctx, "marshal: invalid buffer");
+    }
+
+    /**
+     * @brief 检查能否再写入 size 字节, 每 QUICKJS_MARSHAL_CHECK_INTERVAL 次检查一次截止时间
+     *
+     * @param size
+     * @return bool 超出时抛出JS异常并返回false
+     */
+    bool write_check(size_t size)
+    {
+        if (size > marshal_limit || marshal_buf.size() > marshal_limit - size)
+        {
+            JS_ThrowRangeError(ctx, "marshal: output exceeds %zu bytes", marshal_limit);
+            return false;
+        }
+        if (marshal_deadline && ++marshal_ticks % QUICKJS_MARSHAL_CHECK_INTERVAL == 0 && quickjs_now_us() >= marshal_deadline)
+        {
+            // 与执行超时相同的异常
+            interrupted = true;
+            JS_ThrowInternalError(ctx, "interrupted");
+            return false;
+        }
+        return true;
+    }
+
+    void write_bytes(const void *data, size_t size)
+    {
+        const uint8_t *p = (const uint8_t *)data;
+        marshal_buf.insert(marshal_buf.end(), p, p + size);
+    }
+
+    void write_type(uint8_t type)
+    {
+        marshal_buf.push_back(type);
+    }
+
+    void write_header(uint8_t type, uint32_t n)
+    {
+        write_type(type);
+        write_bytes(&n, sizeof(n));
+    }
+
+    /**
+     * @brief 写入类型化数组
+     *
+     * @param val
+     * @return int 1 已写入, 0 不是类型化数组, -1 超出输出上限
+     */
+    int write_typed_array(JSValue val)
+    {
+        int type = 0;
+        for (int i = 0; i < 3 && !type; i++)
+        {
+            int is = JS_IsInstanceOf(ctx, val, typed_array_ctors[i]);
+            if (is == 1)
+            {
+                type = typed_array_types[i];
+            }
+            else if (is < 0)
+            {
+                JS_FreeValue(ctx, JS_GetException(ctx));
+            }
+        }
+        if (!type)
+        {
+            return 0;
+        }
+
+        size_t offset, byte_len, size;
+        JSValue buffer = JS_GetTypedArrayBuffer(ctx, val, &offset, &byte_len, &size);
+        if (JS_IsException(buffer))
+        {
+            JS_FreeValue(ctx, JS_GetException(ctx));
+            return 0;
+        }
+        size_t buffer_len;
+        const uint8_t *data = JS_GetArrayBuffer(ctx, &buffer_len, buffer);
+        if (!data || offset > buffer_len || byte_len > buffer_len - offset)
+        {
+            // 已分离的 ArrayBuffer 写为空数组, 不对NULL做指针运算
+            JS_FreeValue(ctx, JS_GetException(ctx));
+            data = NULL;
+            byte_len = 0;
+        }
+        if (!write_check(byte_len + sizeof(uint32_t) + size))
+        {
+            JS_FreeValue(ctx, buffer);
+            return -1;
+        }
+        write_header((uint8_t)type, (uint32_t)(byte_len / size));
+        marshal_buf.resize(((marshal_buf.size() + size - 1) / size) * size);
+        if (data)
+        {
+            write_bytes(data + offset, byte_len);
+        }
+        JS_FreeValue(ctx, buffer);
+        return 1;
+    }
+
+    bool write_value(JSValue val, int depth)
+    {
+        if (depth > QUICKJS_MARSHAL_MAX_DEPTH)
+        {
+            JS_ThrowRangeError(ctx, "marshal: nesting too deep or circular reference");
+            return false;
+        }
+        int tag = JS_VALUE_GET_NORM_TAG(val);
+        switch (tag)
+        {
+        case JS_TAG_NULL:
+            write_type(QUICKJS_MARSHAL_NULL);
+            return true;
+        case JS_TAG_BOOL:
+            write_type(JS_VALUE_GET_BOOL(val) ? QUICKJS_MARSHAL_TRUE : QUICKJS_MARSHAL_FALSE);
+            return true;
+        case JS_TAG_INT:
+        {
+            int32_t v = JS_VALUE_GET_INT(val);
+            write_type(QUICKJS_MARSHAL_INT);
+            write_bytes(&v, sizeof(v));
+            return true;
+        }
+        case JS_TAG_FLOAT64:
+        {
+            double v = JS_VALUE_GET_FLOAT64(val);
+            write_type(QUICKJS_MARSHAL_DOUBLE);
+            write_bytes(&v, sizeof(v));
+            return true;
+        }
+        case JS_TAG_STRING:
+        case JS_TAG_BIG_INT:
+        case JS_TAG_BIG_FLOAT:
+        case JS_TAG_BIG_DECIMAL:
+        {
+            size_t n;
+            const char *str = JS_ToCStringLen(ctx, &n, val);
+            if (!str)
+            {
+                return false;
+            }
+            bool ok = write_check(n + 1 + sizeof(uint32_t));
+            if (ok)
+            {
+                write_header(QUICKJS_MARSHAL_STRING, (uint32_t)n);
+                write_bytes(str, n);
+            }
+            JS_FreeCString(ctx, str);
+            return ok;
+        }
+        case JS_TAG_OBJECT:
+            if (JS_IsFunction(ctx, val))
+            {
+                break;
+            }
+            if (JS_IsArray(ctx, val) == 1)
+            {
+                return write_array(val, depth);
+            }
+            if (int typed = write_typed_array(val))
+            {
+                return typed > 0;
+            }
+            return write_object(val, depth);
+        default:
+            break;
+        }
+        write_type(QUICKJS_MARSHAL_UNDEFINED);
+        return true;
+    }
+
+    bool write_array(JSValue val, int depth)
+    {
+        uint32_t n = 0;
+        JSValue len_val = JS_GetPropertyStr(ctx, val, "length");
+        int ret = JS_ToUint32(ctx, &n, len_val);
+        JS_FreeValue(ctx, len_val);
+        if (ret < 0)
+        {
+            return false;
+        }
+        write_header(QUICKJS_MARSHAL_ARRAY, n);
+        for (uint32_t i = 0; i < n; i++)
+        {
+            // 空洞也要写入, 长度很大的稀疏数组只能靠大小上限和超时终止
+            if (!write_check(1))
+            {
+                return false;
+            }
+            JSValue item = JS_GetPropertyUint32(ctx, val, i);
+            bool ok = !JS_IsException(item) && write_value(item, depth + 1);
+            JS_FreeValue(ctx, item);
+            if (!ok)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool write_object(JSValue val, int depth)
+    {
+        JSPropertyEnum *tab;
+        uint32_t len;
+        if (JS_GetOwnPropertyNames(ctx, &tab, &len, val, JS_GPN_STRING_MASK | JS_GPN_ENUM_ONLY) < 0)
+        {
+            return false;
+        }
+        bool ok = true;
+        write_header(QUICKJS_MARSHAL_OBJECT, len);
+        for (uint32_t i = 0; i < len; i++)
+        {
+            ok = ok && write_check(1);
+            if (ok)
+            {
+                const char *key = JS_AtomToCString(ctx, tab[i].atom);
+                JSValue item = key ? JS_GetProperty(ctx, val, tab[i].atom) : JS_EXCEPTION;
+                ok = !JS_IsException(item);
+                if (ok)
+                {
+                    uint32_t key_len = (uint32_t)strlen(key);
+                    write_bytes(&key_len, sizeof(key_len));
+                    write_bytes(key, key_len);
+                    ok = write_value(item, depth + 1);
+                }
+                JS_FreeValue(ctx, item);
+                if (key)
+                {
+                    JS_FreeCString(ctx, key);
+                }
+            }
+            JS_FreeAtom(ctx, tab[i].atom);
+        }
+        js_free(ctx, tab);
+        return ok;
+    }
+
+    // 内置对象的初始属性, 访问器属性保存 getter/setter
+    struct BaselineProperty
+    {
+        JSAtom atom;
+        JSValue value;
+        JSValue getter;
+        JSValue setter;
+        int flags;
+    };
+
+    // 内置对象的初始状态
+    struct BaselineObject
+    {
+        JSValue obj;
+        JSValue proto;
+        bool extensible;
+        std::vector<BaselineProperty> props;
+    };
+
+    /**
+     * @brief 判断两个值是否为同一个值 (对象比较引用)
+     *
+     * @param a
+     * @param b
+     * @return bool
+     */
+    static bool quickjs_same_value(JSValue a, JSValue b)
+    {
+        int tag = JS_VALUE_GET_TAG(a);
+        if (tag != JS_VALUE_GET_TAG(b))
+        {
+            return false;
+        }
+        if (JS_VALUE_HAS_REF_COUNT(a))
+        {
+            return JS_VALUE_GET_PTR(a) == JS_VALUE_GET_PTR(b);
+        }
+        if (JS_TAG_IS_FLOAT64(tag))
+        {
+            double x = JS_VALUE_GET_FLOAT64(a), y = JS_VALUE_GET_FLOAT64(b);
+            return memcmp(&x, &y, sizeof(double)) == 0;
+        }
+        return JS_VALUE_GET_INT(a) == JS_VALUE_GET_INT(b);
+    }
+
+    /**
+     * @brief 记录全局对象的初始属性, 供 quickjs_reset 还原
+     */
+    void save_baseline()
+    {
+        baseline.push_back(snapshot_object(JS_GetGlobalObject(ctx)));
+    }
+
+    /**
+     * @brief 记录一个对象的原型、可扩展性和所有自有属性
+     *
+     * 读取属性会实例化 QuickJS 延迟创建的内置方法
+     *
+     * @param obj 所有权转移给返回值
+     * @return BaselineObject
+     */
+    BaselineObject snapshot_object(JSValue obj)
+    {
+        BaselineObject object{obj, JS_GetPrototype(ctx, obj), JS_IsExtensible(ctx, obj) == 1, {}};
+        JSPropertyEnum *tab;
+        uint32_t len;
+        if (JS_GetOwnPropertyNames(ctx, &tab, &len, obj, JS_GPN_STRING_MASK | JS_GPN_SYMBOL_MASK) == 0)
+        {
+            for (uint32_t i = 0; i < len; i++)
+            {
+                JSPropertyDescriptor desc;
+                if (JS_GetOwnProperty(ctx, &desc, obj, tab[i].atom) == 1)
+                {
+                    object.props.push_back(BaselineProperty{JS_DupAtom(ctx, tab[i].atom), desc.value, desc.getter, desc.setter,
+                                                            desc.flags & (JS_PROP_C_W_E | JS_PROP_GETSET)});
+                }
+                JS_FreeAtom(ctx, tab[i].atom);
+            }
+            js_free(ctx, tab);
+        }
+        JS_FreeValue(ctx, JS_GetException(ctx));
+        return object;
+    }
+
+    /**
+     * @brief 还原一个内置对象: 删除新增属性, 还原被修改或删除的属性和原型
+     *
+     * 属性未增删时 JS_GetOwnPropertyNames 的顺序与记录时一致, 只需逐个比较属性值
+     *
+     * @param object
+     * @param is_global 全局对象上删除失败的属性置为 undefined
+     * @return bool 无法还原时返回false
+     */
+    bool restore_baseline(const BaselineObject &object, bool is_global)
+    {
+        bool clean = true;
+        if (JS_IsExtensible(ctx, object.obj) != (int)object.extensible)
+        {
+            clean = false;
+        }
+        JSValue proto = JS_GetPrototype(ctx, object.obj);
+        if (!quickjs_same_value(proto, object.proto) && JS_SetPrototype(ctx, object.obj, object.proto) != 1)
+        {
+            clean = false;
+        }
+        JS_FreeValue(ctx, proto);
+
+        JSPropertyEnum *tab;
+        uint32_t len;
+        if (JS_GetOwnPropertyNames(ctx, &tab, &len, object.obj, JS_GPN_STRING_MASK | JS_GPN_SYMBOL_MASK) == 0)
+        {
+            bool same_keys = len == object.props.size();
+            for (uint32_t i = 0; same_keys && i < len; i++)
+            {
+                same_keys = tab[i].atom == object.props[i].atom;
+            }
+            if (!same_keys)
+            {
+                std::unordered_set<JSAtom> atoms;
+                for (auto &prop : object.props)
+                {
+                    atoms.insert(prop.atom);
+                }
+                for (uint32_t i = 0; i < len; i++)
+                {
+                    if (!atoms.count(tab[i].atom) && JS_DeleteProperty(ctx, object.obj, tab[i].atom, 0) != 1)
+                    {
+                        if (!is_global || JS_SetProperty(ctx, object.obj, tab[i].atom, JS_UNDEFINED) < 0)
+                        {
+                            clean = false;
+                        }
+                    }
+                }
+            }
+            for (uint32_t i = 0; i < len; i++)
+            {
+                JS_FreeAtom(ctx, tab[i].atom);
+            }
+            js_free(ctx, tab);
+        }
+
+        for (auto &prop : object.props)
+        {
+            JSPropertyDescriptor desc;
+            if (JS_GetOwnProperty(ctx, &desc, object.obj, prop.atom) == 1)
+            {
+                bool same = (desc.flags & (JS_PROP_C_W_E | JS_PROP_GETSET)) == prop.flags &&
+                            quickjs_same_value(desc.value, prop.value) &&
+                            quickjs_same_value(desc.getter, prop.getter) &&
+                            quickjs_same_value(desc.setter, prop.setter);
+                JS_FreeValue(ctx, desc.value);
+                JS_FreeValue(ctx, desc.getter);
+                JS_FreeValue(ctx, desc.setter);
+                if (same)
+                {
+                    continue;
+                }
+            }
+            int flags = JS_PROP_HAS_CONFIGURABLE | JS_PROP_HAS_ENUMERABLE | (prop.flags & (JS_PROP_CONFIGURABLE | JS_PROP_ENUMERABLE));
+            if (prop.flags & JS_PROP_GETSET)
+            {
+                flags |= JS_PROP_HAS_GET | JS_PROP_HAS_SET;
+            }
+            else
+            {
+                flags |= JS_PROP_HAS_VALUE | JS_PROP_HAS_WRITABLE | (prop.flags & JS_PROP_WRITABLE);
+            }
+            if (JS_DefineProperty(ctx, object.obj, prop.atom, prop.value, prop.getter, prop.setter, flags) != 1)
+            {
+                clean = false;
+            }
+        }
+        JS_FreeValue(ctx, JS_GetException(ctx));
+        return clean;
+    }
+
+    // 已加载到当前运行时的字节码函数, 以源码hash为键
+    struct CompiledFunction
+    {
+        const std::vector<uint8_t> *code;
+        JSValue fun;
+    };
+
+    std::unique_ptr<QuickJSArena> arena;   // 必须在 rt 之前构造, 在 rt 释放之后析构
+    QuickJSAllocCounter alloc_counter = {}; // 计数分配器的计数器, 同样须在 rt 之前构造
+    JSRuntime *rt;
+    JSContext *ctx;
+    std::unordered_map<uint64_t, CompiledFunction> functions;
+    std::vector<BaselineObject> baseline;
+    unsigned resets = 0;
+    std::vector<uint8_t> marshal_buf;
+    size_t marshal_limit = QUICKJS_MARSHAL_MAX_SIZE;
+    uint64_t marshal_deadline = 0;
+    uint32_t marshal_ticks = 0;
+    // quickjs_to_buffer 期间缓存的类型化数组构造函数
+    static constexpr int typed_array_types[3] = {QUICKJS_MARSHAL_FLOAT64_ARRAY, QUICKJS_MARSHAL_INT32_ARRAY, QUICKJS_MARSHAL_UINT8_ARRAY};
+    JSValue typed_array_ctors[3];
+    std::vector<HandleSlot> slots;
+    std::deque<uint32_t> free_slots;
+    size_t live_handles = 0;
+    size_t invalid_uses = 0;
+    bool debug = false;
+    std::string last_error;
+    // 资源限制
+    size_t memory_limit = 0;
+    uint64_t timeout_us = 0;
+    uint32_t check_interval = 1;
+    uint32_t ticks = 0;
+    uint64_t deadline = 0; // 0 为无截止时间
+    bool interrupted = false;
+    bool track_usage = false;
+    bool gc_threshold_set = false;
+    int eval_depth = 0;
+    uint64_t eval_start = 0;
+    uint64_t eval_limit_hits = 0; // 执行开始时超出内存上限的累计次数
+    int64_t eval_malloc_size = 0;
+    QuickJSEvalUsage last_usage = {};
+    // 宿主函数
+    QuickJSHostCallback host_callback = NULL;
+    std::vector<std::vector<QuickJSHandle_t>> host_argv; // 按调用深度预分配的参数数组
+    size_t host_depth = 0;
+    bool host_error_set = false;
+    std::string host_error;
+    // 定时器
+    std::vector<Timer> timers;
+    int64_t next_timer_id = 1;
+    // 累计计数
+    QuickJSCounters counters = {};
+    uint64_t eval_parse_us = 0;
+    uint64_t arena_allocations = 0; // 清零计数时专用分配器的累计分配次数
+    static JSClassID gc_sentinel_class_id;
+    JSValue gc_sentinel = JS_UNDEFINED;
+    JS_MarkFunc *gc_decref_func = NULL;
+};
+
+JSClassID QuickJS::gc_sentinel_class_id = 0;
+
+/**
+ * @brief 预热的运行时池, 避免每个请求重新创建运行时和内置对象
+ *
+ * 归还时通过 quickjs_reset 还原全局对象和内置对象, 使用 max_uses 次后、无法还原或调用方要求丢弃时重建
+ */
+class QuickJSPool
+{
+public:
+    QuickJSPool(int size, int max_uses, bool process_global = false)
+        : size(size > 0 ? size : 1), max_uses(max_uses), process_global(process_global)
+    {
+        for (int i = 0; i < this->size; i++)
+        {
+            idle.push_back(create());
+        }
+    }
+    ~QuickJSPool()
+    {
+        for (QuickJS *quickjs : idle)
+        {
+            delete quickjs;
+        }
+    }
+
+    // 禁用拷贝构造函数和赋值操作符以防止资源双重释放等问题
+    QuickJSPool(const QuickJSPool &) = delete;
+    QuickJSPool &operator=(const QuickJSPool &) = delete;
+
+    /**
+     * @brief 进程级运行时池, 与 QuickJSScriptCache 一样每个进程一份
+     *
+     * 不随静态对象析构释放, 避免进程退出时与宿主的清理顺序冲突
+     *
+     * @param size 仅首次调用时生效
+     * @param max_uses 仅首次调用时生效
+     * @return QuickJSPool*
+     */
+    static QuickJSPool *global(int size, int max_uses)
+    {
+        static QuickJSPool *pool = new QuickJSPool(size, max_uses, true);
+        return pool;
+    }
+
+    bool is_global() const
+    {
+        return process_global;
+    }
+
+    /**
+     * @brief 取出一个运行时, 池为空时新建
+     *
+     * @return QuickJS*
+     */
+    QuickJS *acquire()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!idle.empty())
+            {
+                QuickJS *quickjs = idle.back();
+                idle.pop_back();
+                return quickjs;
+            }
+        }
+        return create();
+    }
+
+    /**
+     * @brief 归还运行时
+     *
+     * @param quickjs
+     * @param discard 为true时直接销毁, 不再复用 (例如脚本使用了顶层 let/const)
+     */
+    void release(QuickJS *quickjs, bool discard)
+    {
+        if (!discard && (max_uses <= 0 || quickjs->quickjs_reset_count() + 1 < (unsigned)max_uses) && quickjs->quickjs_reset())
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if ((int)idle.size() < size)
+            {
+                idle.push_back(quickjs);
+                return;
+            }
+        }
+        delete quickjs;
+    }
+
+private:
+    /**
+     * @brief 创建运行时并记录内置对象, 归还时还原脚本对内置原型等的修改
+     *
+     * @return QuickJS*
+     */
+    static QuickJS *create()
+    {
+        QuickJS *quickjs = new QuickJS();
+        quickjs->quickjs_track_builtins();
+        return quickjs;
+    }
+
+    int size;
+    int max_uses;
+    bool process_global;
+    std::mutex mutex;
+    std::vector<QuickJS *> idle;
+};
+
+/**
+ * @brief 批量执行, 同一个预编译脚本在多个线程上处理一组输入, 结果按输入顺序保存
+ *
+ * 脚本的执行结果须为函数, 每个线程创建自己的运行时 (与 quickjs-libc 的 Worker 一样互相隔离),
+ * 执行一次脚本取得函数后, 对分到的每个输入调用 fn(input, index)。输入和结果均为结构化数据二进制格式。
+ * 输入先按线程平均分段, 线程处理完自己的一段后从其他线程剩余部分的尾部窃取一半。
+ */
+class QuickJSBatch
+{
+public:
+    /**
+     * @param script
+     * @param inputs 所有输入拼接而成的缓冲区, 执行期间须保持有效
+     * @param offsets count+1 个偏移, 第i个输入为 [offsets[i], offsets[i+1])
+     * @param count
+     * @param threads 线程数, 0 为CPU核数
+     * @param timeout_us 单个输入的超时时间, 0 为不限制
+     */
+    QuickJSBatch(const QuickJSScript *script, const char *inputs, const size_t *offsets, size_t count, int threads, uint64_t timeout_us)
+        : script(script), inputs(inputs), offsets(offsets), timeout_us(timeout_us), results(count)
+    {
+        size_t n = threads > 0 ? (size_t)threads : std::thread::hardware_concurrency();
+        if (n > count)
+        {
+            n = count;
+        }
+        queues = std::vector<Queue>(n ? n : 1);
+        for (size_t i = 0; i < queues.size(); i++)
+        {
+            queues[i].begin = count * i / queues.size();
+            queues[i].end = count * (i + 1) / queues.size();
+        }
+    }
+
+    // 禁用拷贝构造函数和赋值操作符以防止资源双重释放等问题
+    QuickJSBatch(const QuickJSBatch &) = delete;
+    QuickJSBatch &operator=(const QuickJSBatch &) = delete;
+
+    /**
+     * @brief 执行, 全部输入处理完后返回
+     */
+    void run()
+    {
+        std::vector<std::thread> workers;
+        for (size_t i = 1; i < queues.size(); i++)
+        {
+            workers.emplace_back(&QuickJSBatch::work, this, i);
+        }
+        // 调用线程也作为一个工作线程
+        work(0);
+        for (std::thread &worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    size_t count() const
+    {
+        return results.size();
+    }
+
+    /**
+     * @brief 获取结果
+     *
+     * @param index
+     * @param len 输出长度
+     * @return const uint8_t* 二进制格式, 该输入执行失败时返回NULL
+     */
+    const uint8_t *result(size_t index, size_t *len) const
+    {
+        if (index >= results.size() || !results[index].ok)
+        {
+            return NULL;
+        }
+        *len = results[index].data.size();
+        return results[index].data.data();
+    }
+
+    /**
+     * @brief 获取异常信息
+     *
+     * @param index
+     * @param buf 调用方缓冲区
+     * @param buf_len
+     * @return size_t 异常信息长度, 执行成功时为0
+     */
+    size_t error(size_t index, char *buf, size_t buf_len) const
+    {
+        if (index >= results.size() || results[index].ok)
+        {
+            return quickjs_copy_string("", 0, buf, buf_len);
+        }
+        const std::vector<uint8_t> &data = results[index].data;
+        return quickjs_copy_string((const char *)data.data(), data.size(), buf, buf_len);
+    }
+
+private:
+    // 每个线程的待处理区间 [begin, end), 自己从头部取, 其他线程从尾部窃取
+    struct Queue
+    {
+        std::mutex mutex;
+        size_t begin = 0;
+        size_t end = 0;
+    };
+
+    // 成功时 data 为二进制格式的结果, 失败时为异常信息
+    struct Result
+    {
+        std::vector<uint8_t> data;
+        bool ok = false;
+    };
+
+    /**
+     * @brief 取下一个输入, 自己的区间为空时窃取
+     *
+     * @param id 线程序号
+     * @param index 输出
+     * @return bool 全部输入已分配完时返回false
+     */
+    bool next(size_t id, size_t *index)
+    {
+        Queue &own = queues[id];
+        {
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (own.begin < own.end)
+            {
+                *index = own.begin++;
+                return true;
+            }
+        }
+        for (size_t i = 1; i < queues.size(); i++)
+        {
+            Queue &victim = queues[(id + i) % queues.size()];
+            size_t begin, end;
+            {
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if (victim.begin >= victim.end)
+                {
+                    continue;
+                }
+                end = victim.end;
+                begin = victim.begin + (victim.end - victim.begin) / 2;
+                victim.end = begin;
+            }
+            // 窃取到的区间至少有1个, 第一个直接处理, 其余放入自己的区间
+            std::lock_guard<std::mutex> lock(own.mutex);
+            own.begin = begin + 1;
+            own.end = end;
+            *index = begin;
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief 工作线程
+     *
+     * @param id 线程序号
+     */
+    void work(size_t id)
+    {
+        QuickJS quickjs;
+        quickjs.quickjs_set_timeout(timeout_us, 0);
+        QuickJSHandle_t fun = quickjs.quickjs_run_compiled(script);
+        std::string setup_error;
+        if (quickjs.quickjs_is_exception(fun))
+        {
+            setup_error = exception(quickjs);
+        }
+
+        size_t index;
+        while (next(id, &index))
+        {
+            Result &result = results[index];
+            if (!setup_error.empty())
+            {
+                result.data.assign(setup_error.begin(), setup_error.end());
+                continue;
+            }
+            QuickJSHandle_t args[2] = {
+                quickjs.quickjs_new_from_buffer(inputs + offsets[index], offsets[index + 1] - offsets[index]),
+                quickjs.quickjs_new_double((double)index),
+            };
+            QuickJSHandle_t ret = quickjs.quickjs_call(fun, 2, args);
+            size_t len;
+            const uint8_t *buf = quickjs.quickjs_is_exception(ret) ? NULL : quickjs.quickjs_to_buffer(ret, &len);
+            try
+            {
+                if (buf)
+                {
+                    result.data.assign(buf, buf + len);
+                    result.ok = true;
+                }
+                else
+                {
+                    std::string error = exception(quickjs);
+                    result.data.assign(error.begin(), error.end());
+                }
+            }
+            catch (const std::bad_alloc &)
+            {
+                // 异常不能逃出工作线程
+                static const char oom[] = "InternalError: out of memory";
+                std::vector<uint8_t>().swap(result.data);
+                result.data.assign(oom, oom + sizeof(oom) - 1);
+                result.ok = false;
+            }
+            quickjs.quickjs_release(args[0]);
+            quickjs.quickjs_release(args[1]);
+            quickjs.quickjs_release(ret);
+        }
+    }
+
+    /**
+     * @brief 取出当前异常信息
+     *
+     * @param quickjs
+     * @return std::string
+     */
+    static std::string exception(QuickJS &quickjs)
+    {
+        std::string error(quickjs.quickjs_get_exception(NULL, 0), '\0');
+        quickjs.quickjs_get_exception(&error[0], error.size() + 1);
+        return error.empty() ? std::string("unknown exception") : error;
+    }
+
+    const QuickJSScript *script;
+    const char *inputs;
+    const size_t *offsets;
+    uint64_t timeout_us;
+    std::vector<Result> results;
+    std::vector<Queue> queues;
+};
+
+typedef void *QuickJSScript_t;
+typedef void *QuickJSPool_t;
+typedef void *QuickJSBatch_t;
+
+typedef void *QuickJS_t;
+
+// ---------------- 导出函数
+extern "C"
+{
+    QuickJS_t quickjs_create();                                                                                                                // 创建
+    void quickjs_free(QuickJS_t quickjs);                                                                                                      // 释放
+    QuickJSHandle_t quickjs_eval(QuickJS_t quickjs, const char *js_code);                                                                      // 执行js代码
+    bool quickjs_is_exception(QuickJS_t quickjs, QuickJSHandle_t handle);                                                                      // 判断是否是异常
+    size_t quickjs_js_ToCString(QuickJS_t quickjs, QuickJSHandle_t handle, char *buf, size_t buf_len);                                         // 转字符串
+    int quickjs_js_ToBool(QuickJS_t quickjs, QuickJSHandle_t handle);                                                                          // 转bool
+    int quickjs_js_ToInt(QuickJS_t quickjs, QuickJSHandle_t handle);                                                                           // 转int
+    size_t quickjs_get_exception(QuickJS_t quickjs, char *buf, size_t buf_len);                                                                // 获取异常信息
+    QuickJSHandle_t quickjs_new_undefined(QuickJS_t quickjs);                                                                                  // 创建一个JS的undefined值
+    QuickJSHandle_t quickjs_new_null(QuickJS_t quickjs);                                                                                       // 创建一个JS的null值
+    QuickJSHandle_t quickjs_new_true(QuickJS_t quickjs);                                                                                       // 创建一个JS的true值
+    QuickJSHandle_t quickjs_new_false(QuickJS_t quickjs);                                                                                      // 创建一个JS的false值
+    QuickJSHandle_t quickjs_new_string(QuickJS_t quickjs, const char *str);                                                                    // 创建一个JS的字符串
+    QuickJSHandle_t quickjs_new_int(QuickJS_t quickjs, int val);                                                                               // 创建一个JS的int
+    QuickJSHandle_t quickjs_new_json(QuickJS_t quickjs, const char *str);                                                                      // 字符串转json对象
+    QuickJSHandle_t quickjs_new_double(QuickJS_t quickjs, double val);                                                                         // 创建一个JS的double
+    int quickjs_set_property_str(QuickJS_t quickjs, const char *property_name, QuickJSHandle_t handle);                                        // 设置全局变量
+    QuickJSScript_t quickjs_compile(QuickJS_t quickjs, const char *js_code, const char *cache_dir);                                            // 编译js代码为字节码
+    QuickJSHandle_t quickjs_run_compiled(QuickJS_t quickjs, QuickJSScript_t script);                                                           // 执行预编译的字节码
+    QuickJSScript_t quickjs_script_load(const char *buf, size_t len);                                                                          // 从字节码创建预编译脚本
+    const uint8_t *quickjs_script_bytecode(QuickJSScript_t script);                                                                            // 获取字节码
+    size_t quickjs_script_size(QuickJSScript_t script);                                                                                        // 获取字节码长度
+    void quickjs_script_free(QuickJSScript_t script);                                                                                          // 释放预编译脚本
+    void quickjs_script_cache_clear();                                                                                                         // 清空进程内字节码缓存
+    int quickjs_reset(QuickJS_t quickjs);                                                                                                      // 重置运行时
+    QuickJSPool_t quickjs_pool_create(int size, int max_uses);                                                                                 // 创建运行时池
+    QuickJS_t quickjs_pool_acquire(QuickJSPool_t pool);                                                                                        // 从池中取出运行时
+    void quickjs_pool_release(QuickJSPool_t pool, QuickJS_t quickjs, int discard);                                                             // 归还运行时
+    void quickjs_pool_free(QuickJSPool_t pool);                                                                                                // 释放运行时池
+    QuickJSPool_t quickjs_pool_global(int size, int max_uses);                                                                                 // 获取进程级运行时池
+    void quickjs_track_builtins(QuickJS_t quickjs);                                                                                            // 记录内置对象, 重置时一并还原
+    QuickJSHandle_t quickjs_new_typed_array(QuickJS_t quickjs, void *data, size_t count, int type, int copy);                                  // 创建类型化数组
+    QuickJSHandle_t quickjs_new_from_buffer(QuickJS_t quickjs, const char *buf, size_t len);                                                   // 从二进制缓冲区创建JS值
+    const uint8_t *quickjs_to_buffer(QuickJS_t quickjs, QuickJSHandle_t handle, size_t *len);                                                  // 将JS值写入二进制缓冲区
+    const uint8_t *quickjs_eval_to_buffer(QuickJS_t quickjs, const char *js_code, size_t *len);                                                // 执行js代码并将结果写入二进制缓冲区
+    int quickjs_release(QuickJS_t quickjs, QuickJSHandle_t handle);                                                                            // 释放句柄
+    int quickjs_release_batch(QuickJS_t quickjs, const QuickJSHandle_t *handles, int count);                                                   // 批量释放句柄
+    void quickjs_release_all(QuickJS_t quickjs);                                                                                               // 释放所有句柄
+    void quickjs_set_debug(QuickJS_t quickjs, int enable);                                                                                     // 开关调试模式
+    int quickjs_handle_count(QuickJS_t quickjs);                                                                                               // 获取存活的句柄数量
+    size_t quickjs_debug_report(QuickJS_t quickjs, char *buf, size_t buf_len);                                                                 // 获取调试报告
+    QuickJS_t quickjs_create_arena(size_t chunk_size);                                                                                         // 使用专用分配器创建
+    int quickjs_alloc_stats(QuickJS_t quickjs, QuickJSAllocStats *stats);                                                                      // 获取专用分配器统计
+    void quickjs_set_memory_limit(QuickJS_t quickjs, size_t limit);                                                                            // 设置内存上限
+    void quickjs_set_max_stack_size(QuickJS_t quickjs, size_t stack_size);                                                                     // 设置最大栈深度
+    void quickjs_set_gc_threshold(QuickJS_t quickjs, size_t gc_threshold);                                                                     // 设置自动GC阈值
+    void quickjs_set_timeout(QuickJS_t quickjs, uint64_t timeout_us, uint32_t check_interval);                                                 // 设置单次执行超时
+    void quickjs_set_usage_tracking(QuickJS_t quickjs, int enable);                                                                            // 开关内存统计
+    void quickjs_last_usage(QuickJS_t quickjs, QuickJSEvalUsage *usage);                                                                       // 获取最近一次执行的资源使用
+    QuickJSHandle_t quickjs_new_function(QuickJS_t quickjs, const char *name, int length, int32_t function_id);                                // 创建一个调用宿主函数的JS函数
+    void quickjs_set_host_callback(QuickJS_t quickjs, QuickJSHostCallback callback);                                                           // 设置宿主回调
+    void quickjs_throw_error(QuickJS_t quickjs, const char *message);                                                                          // 宿主函数向JS抛出异常
+    QuickJSHandle_t quickjs_call(QuickJS_t quickjs, QuickJSHandle_t func, int argc, const QuickJSHandle_t *argv);                              // 调用JS函数
+    QuickJSBatch_t quickjs_batch_run(QuickJSScript_t script, const char *inputs, const size_t *offsets, size_t count, int threads, uint64_t timeout_us); // 多线程批量执行
+    size_t quickjs_batch_count(QuickJSBatch_t batch);                                                                                          // 获取批量执行的结果数量
+    const uint8_t *quickjs_batch_result(QuickJSBatch_t batch, size_t index, size_t *len);                                                      // 获取批量执行的结果
+    size_t quickjs_batch_error(QuickJSBatch_t batch, size_t index, char *buf, size_t buf_len);                                                 // 获取批量执行的异常信息
+    void quickjs_batch_free(QuickJSBatch_t batch);                                                                                             // 释放批量执行结果
+    int quickjs_run_jobs(QuickJS_t quickjs, int max_jobs, uint64_t max_us);                                                                    // 执行待执行的任务和到期的定时器
+    int64_t quickjs_pending(QuickJS_t quickjs);                                                                                                // 查询是否还有待执行的工作
+    int quickjs_promise_state(QuickJS_t quickjs, QuickJSHandle_t handle);                                                                      // 获取Promise的状态
+    QuickJSHandle_t quickjs_await(QuickJS_t quickjs, QuickJSHandle_t handle, uint64_t max_us);                                                 // 等待Promise完成
+    void quickjs_get_counters(QuickJS_t quickjs, QuickJSCounters *counters);                                                                   // 获取累计计数
+    void quickjs_reset_counters(QuickJS_t quickjs);                                                                                            // 清零累计计数
+    void quickjs_run_gc(QuickJS_t quickjs);                                                                                                    // 执行GC
+
+    /**
+     * @brief 创建
+     *
+     * @return QuickJS_t
+     */
+    EXPORT QuickJS_t quickjs_create()
+    {
+        return new QuickJS();
+    }
+
+    /**
+     * @brief 执行js代码
+     *
+     * @param quickjs
+     * @param js_code
+     * @return QuickJSHandle_t
+     */
+    EXPORT QuickJSHandle_t quickjs_eval(QuickJS_t quickjs, const char *js_code)
+    {
+        return ((QuickJS *)quickjs)->quickjs_eval(js_code);
+    }
+
+    /**
+     * @brief 转字符串
+     *
+     * @param quickjs
+     * @param handle
+     * @param buf 调用方缓冲区
+     * @param buf_len
+     * @return size_t 字符串长度, 大于等于 buf_len 时说明被截断
+     */
+    EXPORT size_t quickjs_js_ToCString(QuickJS_t quickjs, QuickJSHandle_t handle, char *buf, size_t buf_len)
+    {
+        return ((QuickJS *)quickjs)->quickjs_js_ToCString(handle, buf, buf_len);
+    }
+
+    /**
+     * @brief 转bool
+     *
+     * @param quickjs
+     * @param handle
+     * @return int
+     */
+    EXPORT int quickjs_js_ToBool(QuickJS_t quickjs, QuickJSHandle_t handle)
+    {
+        return ((QuickJS *)quickjs)->quickjs_js_ToBool(handle);
+    }
+
+    /**
+     * @brief 转int
+     *
+     * @param quickjs
+     * @param handle
+     * @return int
+     */
+    EXPORT int quickjs_js_ToInt(QuickJS_t quickjs, QuickJSHandle_t handle)
+    {
+        return ((QuickJS *)quickjs)->quickjs_js_ToInt(handle);
+    }
+
+    /**
+     * @brief 判断是否是异常
+     *
+     * @param quickjs
+     * @param handle
+     * @return true
+     * @return false
+     */
+    EXPORT bool quickjs_is_exception(QuickJS_t quickjs, QuickJSHandle_t handle)
+    {
+        return ((QuickJS *)quickjs)->quickjs_is_exception(handle);
+    }
+
+    /**
+     * @brief 获取异常信息
+     *
+     * @param quickjs
+     * @param buf 调用方缓冲区
+     * @param buf_len
+     * @return size_t 异常信息长度, 大于等于 buf_len 时说明被截断
+     */
+    EXPORT size_t quickjs_get_exception(QuickJS_t quickjs, char *buf, size_t buf_len)
+    {
+        return ((QuickJS *)quickjs)->quickjs_get_exception(buf, buf_len);
+    }
+
+    /**
+     * @brief 释放
+     *
+     * @param quickjs
+     */
+    EXPORT void quickjs_free(QuickJS_t quickjs)
+    {
+        delete static_cast<QuickJS *>(quickjs);
+    }
+
+    /**
+     * @brief 创建一个JS的undefined值
+     *
+     * @param quickjs
+     * @return QuickJSHandle_t
+     */
+    EXPORT QuickJSHandle_t quickjs_new_undefined(QuickJS_t quickjs)
+    {
+        return ((QuickJS *)quickjs)->quickjs_new_undefined();
+    }
+
+    /**
+     * @brief 创建一个JS的null值
+     *
+     * @param quickjs
+     * @return QuickJSHandle_t
+     */
+    EXPORT QuickJSHandle_t quickjs_new_null(QuickJS_t quickjs)
+    {
+        return ((QuickJS *)quickjs)->quickjs_new_null();
+    }
+
+    /**
+     * @brief 创建一个JS的true值
+     *
+     * @param quickjs
+     * @return QuickJSHandle_t
+     */
+    EXPORT QuickJSHandle_t quickjs_new_true(QuickJS_t quickjs)
+    {
+        return ((QuickJS *)quickjs)->quickjs_new_true();
+    }
+
+    /**
+     * @brief 创建一个JS的false值
+     *
+     * @param quickjs
+     * @return QuickJSHandle_t
+     */
+    EXPORT QuickJSHandle_t quickjs_new_false(QuickJS_t quickjs)
+    {
+        return ((QuickJS *)quickjs)->quickjs_new_false();
+    }
+
+    /**
+     * @brief 创建一个JS的字符串
+     *
+     * @param quickjs
+     * @param str
+     * @return QuickJSHandle_t
+     */
+    EXPORT QuickJSHandle_t quickjs_new_string(QuickJS_t quickjs, const char *str)
+    {
+        return ((QuickJS *)quickjs)->quickjs_new_string(str);
+    }
+
+    /**
+     * @brief 创建一个JS的int
+     *
+     * @param quickjs
+     * @param val
+     * @return QuickJSHandle_t
+     */
+    EXPORT QuickJSHandle_t quickjs_new_int(QuickJS_t quickjs, int val)
+    {
+        return ((QuickJS *)quickjs)->quickjs_new_int(val);
+    }
+
+    /**
+     * @brief 字符串转json对象
+     *
+     * @param quickjs
+     * @param str
+     * @return QuickJSHandle_t
+     */
+    EXPORT QuickJSHandle_t quickjs_new_json(QuickJS_t quickjs, const char *str)
+    {
+        return ((QuickJS *)quickjs)->quickjs_str_to_json(str);
+    }
+
+    /**
+     * @brief 创建一个JS的double
+     *
+     * @param quickjs
+     * @param val
+     * @return QuickJSHandle_t
+     */
+    EXPORT QuickJSHandle_t quickjs_new_double(QuickJS_t quickjs, double val)
+    {
+        return ((QuickJS *)quickjs)->quickjs_new_double(val);
+    }
+
+    /**
+     * @brief 设置全局变量
+     *
+     * @param quickjs
+     * @param property_name 变量名
+     * @param handle 值, 句柄仍需调用方释放
+     * @return int
+     */
+    EXPORT int quickjs_set_property_str(QuickJS_t quickjs, const char *property_name, QuickJSHandle_t handle)
+    {
+        return ((QuickJS *)quickjs)->quickjs_set_property_str(property_name, handle);
+    }
 
-//---------------- 设置导出名 `EXPORT` (全大写可加下划线、可自定义,例如 ASD_API)
-#ifdef _WIN32
-#define EXPORT __declspec(dllexport)
-#else
-#define EXPORT
-#endif
+    /**
+     * @brief 编译js代码为字节码
+     *
+     * @param quickjs
+     * @param js_code
+     * @param cache_dir 磁盘缓存目录, 可为NULL; 须为当前用户所有且组和其他用户不可写, 否则忽略
+     * @return QuickJSScript_t 失败返回NULL
+     */
+    EXPORT QuickJSScript_t quickjs_compile(QuickJS_t quickjs, const char *js_code, const char *cache_dir)
+    {
+        return ((QuickJS *)quickjs)->quickjs_compile(js_code, cache_dir);
+    }
 
-class QuickJS
-{
-public:
-    QuickJS() : rt(JS_NewRuntime()), ctx(JS_NewContext(rt)) {}
-    ~QuickJS()
+    /**
+     * @brief 执行预编译的字节码
+     *
+     * @param quickjs
+     * @param script
+     * @return QuickJSHandle_t
+     */
+    EXPORT QuickJSHandle_t quickjs_run_compiled(QuickJS_t quickjs, QuickJSScript_t script)
     {
-        // 不需要再调用 quickjs_free()
-        JS_FreeContext(ctx);
-        JS_FreeRuntime(rt);
+        return ((QuickJS *)quickjs)->quickjs_run_compiled((QuickJSScript *)script);
     }
 
-    // 禁用拷贝构造函数和赋值操作符以防止资源双重释放等问题
-    QuickJS(const QuickJS &) = delete;
-    QuickJS &operator=(const QuickJS &) = delete;
+    /**
+     * @brief 从字节码创建预编译脚本, 用于从共享内存等外部缓存恢复
+     *
+     * 字节码不做校验, 等同于可执行代码, 只能加载本库导出且未经他人修改的可信数据
+     *
+     * @param buf quickjs_script_bytecode 导出的字节码
+     * @param len
+     * @return QuickJSScript_t
+     */
+    EXPORT QuickJSScript_t quickjs_script_load(const char *buf, size_t len)
+    {
+        const uint8_t *data = (const uint8_t *)buf;
+        auto code = std::make_shared<const std::vector<uint8_t>>(data, data + len);
+        return new QuickJSScript{quickjs_hash_source(buf, len), 0, code};
+    }
 
     /**
-     * @brief 执行js代码
+     * @brief 获取字节码
      *
-     * @param js_code
-     * @return JSValue
+     * @param script
+     * @return const uint8_t*
      */
-    JSValue quickjs_eval(const char *js_code)
+    EXPORT const uint8_t *quickjs_script_bytecode(QuickJSScript_t script)
     {
-        JSValue val = JS_Eval(ctx, js_code, strlen(js_code), "quick.js", JS_EVAL_TYPE_GLOBAL);
-        JS_FreeValue(ctx, val);
-        return val;
+        return ((QuickJSScript *)script)->code->data();
     }
 
     /**
-     * @brief 判断是否是异常
+     * @brief 获取字节码长度
      *
-     * @param val
-     * @return true
-     * @return false
+     * @param script
+     * @return size_t
      */
-    bool quickjs_is_exception(JSValue val)
+    EXPORT size_t quickjs_script_size(QuickJSScript_t script)
     {
-        return JS_IsException(val);
+        return ((QuickJSScript *)script)->code->size();
     }
 
     /**
-     * @brief 获取异常信息
+     * @brief 释放预编译脚本
      *
-     * @return const char *
+     * @param script
      */
-    const char *quickjs_get_exception()
+    EXPORT void quickjs_script_free(QuickJSScript_t script)
     {
-        JSValue val = JS_GetException(ctx);
-        const char *error = JS_ToCString(ctx, val);
-        JS_FreeCString(ctx, error);
-        JS_FreeValue(ctx, val);
-        return error;
+        delete static_cast<QuickJSScript *>(script);
     }
 
     /**
-     * @brief 转字符串
+     * @brief 清空进程内字节码缓存
+     */
+    EXPORT void quickjs_script_cache_clear()
+    {
+        QuickJSScriptCache::instance().clear();
+    }
+
+    /**
+     * @brief 重置运行时, 恢复到刚创建时的全局对象 (以及 quickjs_track_builtins 记录的内置对象),
+     * 内存上限、超时等资源设置还原为默认值
      *
-     * @param val
-     * @return const char*
+     * @param quickjs
+     * @return int 1 已完全还原; 0 内置对象无法还原 (例如被冻结) 或有未执行的 Promise 任务, 运行时不应再复用
      */
-    inline const char *quickjs_js_ToCString(JSValue val)
+    EXPORT int quickjs_reset(QuickJS_t quickjs)
     {
-        const char *str = JS_ToCString(ctx, val);
-        JS_FreeValue(ctx, val);
-        JS_FreeCString(ctx, str);
-        return str;
+        return ((QuickJS *)quickjs)->quickjs_reset() ? 1 : 0;
     }
 
     /**
-     * @brief 转bool
+     * @brief 创建运行时池
      *
-     * @param val
-     * @return int
+     * @param size 预热的运行时数量
+     * @param max_uses 每个运行时最多复用次数, <=0 不限制
+     * @return QuickJSPool_t
      */
-    int quickjs_js_ToBool(JSValue val)
+    EXPORT QuickJSPool_t quickjs_pool_create(int size, int max_uses)
     {
-        int b = JS_ToBool(ctx, val);
-        JS_FreeValue(ctx, val);
-        return b;
+        return new QuickJSPool(size, max_uses);
     }
 
     /**
-     * @brief 转int
+     * @brief 从池中取出运行时, 可用于其他所有 quickjs_* 函数, 用完后调用 quickjs_pool_release 而不是 quickjs_free
      *
-     * @param val
-     * @param pres
-     * @return int
+     * @param pool
+     * @return QuickJS_t
+     */
+    EXPORT QuickJS_t quickjs_pool_acquire(QuickJSPool_t pool)
+    {
+        return ((QuickJSPool *)pool)->acquire();
+    }
+
+    /**
+     * @brief 归还运行时
+     *
+     * @param pool
+     * @param quickjs
+     * @param discard 非0时销毁运行时而不是重置复用
      */
-    int quickjs_js_ToInt(JSValue val)
+    EXPORT void quickjs_pool_release(QuickJSPool_t pool, QuickJS_t quickjs, int discard)
     {
-        int32_t pres;
-        if (JS_ToInt32(ctx, &pres, val))
+        ((QuickJSPool *)pool)->release((QuickJS *)quickjs, discard != 0);
+    }
+
+    /**
+     * @brief 释放运行时池, 调用前需归还所有取出的运行时
+     *
+     * @param pool
+     */
+    EXPORT void quickjs_pool_free(QuickJSPool_t pool)
+    {
+        if (!((QuickJSPool *)pool)->is_global())
         {
-            fprintf(stderr, "Error: failed to convert JS value to int.\n");
+            delete static_cast<QuickJSPool *>(pool);
         }
-        JS_FreeValue(ctx, val);
-        return pres;
     }
 
     /**
-     * @brief 创建一个JS函数
+     * @brief 获取进程级运行时池, 同一进程内每次返回同一个池, PHP-FPM 的各个请求可共享预热好的运行时
      *
-     * @param func 函数指针
-     * @param name 函数名
-     * @param length 参数个数
-     * @return JSValue
+     * 只有首次调用的参数生效; 池随进程退出释放, 对其调用 quickjs_pool_free 无效
+     *
+     * @param size 预热的运行时数量
+     * @param max_uses 每个运行时最多复用次数, <=0 不限制
+     * @return QuickJSPool_t
      */
-    JSValue quickjs_new_function(JSCFunction *func, const char *name,
-                                 int length)
+    EXPORT QuickJSPool_t quickjs_pool_global(int size, int max_uses)
     {
-        JSValue func_val = JS_NewCFunction(ctx, func, name, length);
-        JS_FreeValue(ctx, func_val);
-        return func_val;
+        return QuickJSPool::global(size, max_uses);
     }
 
     /**
-     * @brief 创建一个JS的undefined值
+     * @brief 记录内置构造函数、原型对象等的初始状态, 之后 quickjs_reset 一并还原; 须在执行任何脚本之前调用
      *
-     * @return JSValue
+     * 运行时池创建的运行时会自动调用; 会实例化所有延迟创建的内置方法, 创建耗时和内存约增加一倍
+     *
+     * @param quickjs
      */
-    JSValue quickjs_new_undefined()
+    EXPORT void quickjs_track_builtins(QuickJS_t quickjs)
     {
-        JSValue val = JS_UNDEFINED;
-        JS_FreeValue(ctx, val);
-        return val;
+        ((QuickJS *)quickjs)->quickjs_track_builtins();
     }
 
     /**
-     * @brief 创建一个JS的null值
+     * @brief 创建类型化数组
      *
-     * @return JSValue
+     * @param quickjs
+     * @param data 数据
+     * @param count 元素个数
+     * @param type 9:Uint8Array 10:Int32Array 11:Float64Array
+     * @param copy 为0时不拷贝, 调用方需保证JS对象存活期间 data 有效
+     * @return QuickJSHandle_t
      */
-    JSValue quickjs_new_null()
+    EXPORT QuickJSHandle_t quickjs_new_typed_array(QuickJS_t quickjs, void *data, size_t count, int type, int copy)
     {
-        JSValue val = JS_NULL;
-        JS_FreeValue(ctx, val);
-        return val;
+        return ((QuickJS *)quickjs)->quickjs_new_typed_array(data, count, type, copy != 0);
     }
 
     /**
-     * @brief 创建一个JS的true值
+     * @brief 从二进制缓冲区创建JS值
      *
-     * @return JSValue
+     * @param quickjs
+     * @param buf
+     * @param len
+     * @return QuickJSHandle_t
      */
-    JSValue quickjs_new_true()
+    EXPORT QuickJSHandle_t quickjs_new_from_buffer(QuickJS_t quickjs, const char *buf, size_t len)
     {
-        JSValue val = JS_TRUE;
-        JS_FreeValue(ctx, val);
-        return val;
+        return ((QuickJS *)quickjs)->quickjs_new_from_buffer(buf, len);
     }
 
     /**
-     * @brief 创建一个JS的false值
+     * @brief 将JS值写入二进制缓冲区
      *
-     * @return JSValue
+     * @param quickjs
+     * @param handle
+     * @param len 输出长度
+     * @return const uint8_t* 下次调用前有效, 失败返回NULL
      */
-    JSValue quickjs_new_false()
+    EXPORT const uint8_t *quickjs_to_buffer(QuickJS_t quickjs, QuickJSHandle_t handle, size_t *len)
     {
-        JSValue val = JS_FALSE;
-        JS_FreeValue(ctx, val);
-        return val;
+        return ((QuickJS *)quickjs)->quickjs_to_buffer(handle, len);
     }
 
     /**
-     * @brief 创建一个JS的字符串
+     * @brief 执行js代码并将结果写入二进制缓冲区
      *
-     * @param str
-     * @return JSValue
+     * @param quickjs
+     * @param js_code
+     * @param len 输出长度
+     * @return const uint8_t* 下次调用前有效, 失败返回NULL
      */
-    JSValue quickjs_new_string(const char *str)
+    EXPORT const uint8_t *quickjs_eval_to_buffer(QuickJS_t quickjs, const char *js_code, size_t *len)
     {
-        JSValue val = JS_NewString(ctx, str);
-        JS_FreeValue(ctx, val);
-        return val;
+        return ((QuickJS *)quickjs)->quickjs_eval_to_buffer(js_code, len);
     }
 
     /**
-     * @brief 创建一个JS的int
+     * @brief 释放句柄
      *
-     * @param val
-     * @return JSValue
+     * @param quickjs
+     * @param handle
+     * @return int 成功返回1, 句柄无效返回0
      */
-    JSValue quickjs_new_int(int val)
+    EXPORT int quickjs_release(QuickJS_t quickjs, QuickJSHandle_t handle)
     {
-        JSValue js_val = JS_NewInt32(ctx, val);
-        JS_FreeValue(ctx, js_val);
-        return js_val;
+        return ((QuickJS *)quickjs)->quickjs_release(handle) ? 1 : 0;
     }
 
     /**
-     * @brief 字符串转json对象
+     * @brief 批量释放句柄
      *
-     * @param str
-     * @return JSValue
+     * @param quickjs
+     * @param handles
+     * @param count
+     * @return int 成功释放的数量
      */
-    JSValue quickjs_str_to_json(const char *str)
+    EXPORT int quickjs_release_batch(QuickJS_t quickjs, const QuickJSHandle_t *handles, int count)
     {
-        JSValue js_val = JS_ParseJSON(ctx, str, strlen(str), NULL);
-        JS_FreeValue(ctx, js_val);
-        return js_val;
+        int released = 0;
+        for (int i = 0; i < count; i++)
+        {
+            released += ((QuickJS *)quickjs)->quickjs_release(handles[i]) ? 1 : 0;
+        }
+        return released;
     }
 
     /**
-     * @brief 创建一个JS的double
+     * @brief 释放所有句柄
      *
-     * @param val
-     * @return JSValue
+     * @param quickjs
      */
-    JSValue quickjs_new_double(double val)
+    EXPORT void quickjs_release_all(QuickJS_t quickjs)
     {
-        JSValue js_val = JS_NewFloat64(ctx, val);
-        JS_FreeValue(ctx, js_val);
-        return js_val;
+        ((QuickJS *)quickjs)->quickjs_release_all();
     }
 
     /**
-     * @brief 设置全局变量
+     * @brief 开关调试模式
      *
-     * @param property_name 变量名
-     * @param value         值
+     * @param quickjs
+     * @param enable
+     */
+    EXPORT void quickjs_set_debug(QuickJS_t quickjs, int enable)
+    {
+        ((QuickJS *)quickjs)->quickjs_set_debug(enable != 0);
+    }
+
+    /**
+     * @brief 获取存活的句柄数量
+     *
+     * @param quickjs
      * @return int
      */
-    int quickjs_set_property_str(const char *property_name, JSValue value)
+    EXPORT int quickjs_handle_count(QuickJS_t quickjs)
     {
-        JSValue global_obj = JS_GetGlobalObject(ctx);
-        int sps = JS_SetPropertyStr(ctx, global_obj, property_name, value);
-        JS_FreeValue(ctx, global_obj);
-        return sps;
+        return ((QuickJS *)quickjs)->quickjs_handle_count();
     }
 
-private:
-    JSRuntime *rt;
-    JSContext *ctx;
-};
+    /**
+     * @brief 获取调试报告
+     *
+     * @param quickjs
+     * @param buf 调用方缓冲区
+     * @param buf_len
+     * @return size_t 报告长度, 大于等于 buf_len 时说明被截断
+     */
+    EXPORT size_t quickjs_debug_report(QuickJS_t quickjs, char *buf, size_t buf_len)
+    {
+        return ((QuickJS *)quickjs)->quickjs_debug_report(buf, buf_len);
+    }
 
-typedef void *QuickJS_t;
+    /**
+     * @brief 使用专用分配器创建, 运行时的内存从按大小分级的 arena 中分配, 释放时整块归还
+     *
+     * @param chunk_size 每个 arena 的字节数, 0 为默认256KB
+     * @return QuickJS_t
+     */
+    EXPORT QuickJS_t quickjs_create_arena(size_t chunk_size)
+    {
+        return new QuickJS(chunk_size);
+    }
 
-// ---------------- 导出函数
-extern "C"
-{
-    QuickJS_t quickjs_create();                                                                                                                // 创建
-    void quickjs_free(QuickJS_t quickjs);                                                                                                      // 释放
-    JSValue quickjs_eval(QuickJS_t quickjs, const char *js_code);                                                                              // 执行js代码
-    bool quickjs_is_exception(QuickJS_t quickjs, JSValue val);                                                                                 // 判断是否是异常
-    const char *quickjs_js_ToCString(QuickJS_t quickjs, JSValue val);                                                                          // 转字符串
-    int quickjs_js_ToBool(QuickJS_t quickjs, JSValue val);                                                                                     // 转bool
-    int quickjs_js_ToInt(QuickJS_t quickjs, JSValue val);                                                                                      // 转int
-    const char *quickjs_get_exception(QuickJS_t quickjs);                                                                                      // 获取异常信息
-    JSValue quickjs_new_undefined(QuickJS_t quickjs);                                                                                          // 创建一个JS的undefined值
-    JSValue quickjs_new_null(QuickJS_t quickjs);                                                                                               // 创建一个JS的null值
-    JSValue quickjs_new_true(QuickJS_t quickjs);                                                                                               // 创建一个JS的true值
-    JSValue quickjs_new_false(QuickJS_t quickjs);                                                                                              // 创建一个JS的false值
-    JSValue quickjs_new_string(QuickJS_t quickjs, const char *str);                                                                            // 创建一个JS的字符串
-    JSValue quickjs_new_int(QuickJS_t quickjs, int val);                                                                                       // 创建一个JS的int
-    JSValue quickjs_new_json(QuickJS_t quickjs, const char *str);                                                                              // 字符串转json对象
-    JSValue quickjs_new_double(QuickJS_t quickjs, double val);                                                                                 // 创建一个JS的double
-    int quickjs_set_property_str(QuickJS_t quickjs, const char *property_name, JSValue value);                                                 // 设置全局变量
+    /**
+     * @brief 获取专用分配器统计
+     *
+     * @param quickjs
+     * @param stats
+     * @return int 成功返回0, 未使用专用分配器返回-1
+     */
+    EXPORT int quickjs_alloc_stats(QuickJS_t quickjs, QuickJSAllocStats *stats)
+    {
+        return ((QuickJS *)quickjs)->quickjs_alloc_stats(stats) ? 0 : -1;
+    }
 
     /**
-     * @brief 创建
+     * @brief 设置内存上限
      *
-     * @return QuickJS_t
+     * @param quickjs
+     * @param limit 字节数, 0 为不限制
      */
-    EXPORT QuickJS_t quickjs_create()
+    EXPORT void quickjs_set_memory_limit(QuickJS_t quickjs, size_t limit)
     {
-        return new QuickJS();
+        ((QuickJS *)quickjs)->quickjs_set_memory_limit(limit);
     }
 
     /**
-     * @brief 执行js代码
+     * @brief 设置最大栈深度
      *
      * @param quickjs
-     * @param js_code
-     * @return JSValue
+     * @param stack_size 字节数, 0 为不检查
      */
-    EXPORT JSValue quickjs_eval(QuickJS_t quickjs, const char *js_code)
+    EXPORT void quickjs_set_max_stack_size(QuickJS_t quickjs, size_t stack_size)
     {
-        return ((QuickJS *)quickjs)->quickjs_eval(js_code);
+        ((QuickJS *)quickjs)->quickjs_set_max_stack_size(stack_size);
     }
 
     /**
-     * @brief 转字符串
+     * @brief 设置自动GC阈值
      *
      * @param quickjs
-     * @param val
-     * @return EXPORT const*
+     * @param gc_threshold 字节数, (size_t)-1 为关闭自动GC
      */
-    EXPORT const char *quickjs_js_ToCString(QuickJS_t quickjs, JSValue val)
+    EXPORT void quickjs_set_gc_threshold(QuickJS_t quickjs, size_t gc_threshold)
     {
-        return ((QuickJS *)quickjs)->quickjs_js_ToCString(val);
+        ((QuickJS *)quickjs)->quickjs_set_gc_threshold(gc_threshold);
     }
 
     /**
-     * @brief 转bool
+     * @brief 设置单次执行超时, 作用于 quickjs_eval/quickjs_run_compiled/quickjs_eval_to_buffer/quickjs_call/quickjs_run_jobs,
+     * quickjs_await 中每批任务和定时器分别计时
      *
      * @param quickjs
-     * @param val
-     * @return EXPORT
+     * @param timeout_us 微秒, 0 为不限制
+     * @param check_interval 每多少次中断回调检查一次时钟, 0 视为1
      */
-    EXPORT int quickjs_js_ToBool(QuickJS_t quickjs, JSValue val)
+    EXPORT void quickjs_set_timeout(QuickJS_t quickjs, uint64_t timeout_us, uint32_t check_interval)
     {
-        return ((QuickJS *)quickjs)->quickjs_js_ToBool(val);
+        ((QuickJS *)quickjs)->quickjs_set_timeout(timeout_us, check_interval);
     }
 
     /**
-     * @brief 转int
+     * @brief 开关内存统计
      *
      * @param quickjs
-     * @param val
-     * @return EXPORT
+     * @param enable
      */
-    EXPORT int quickjs_js_ToInt(QuickJS_t quickjs, JSValue val)
+    EXPORT void quickjs_set_usage_tracking(QuickJS_t quickjs, int enable)
     {
-        return ((QuickJS *)quickjs)->quickjs_js_ToInt(val);
+        ((QuickJS *)quickjs)->quickjs_set_usage_tracking(enable != 0);
     }
 
     /**
-     * @brief 判断是否是异常
+     * @brief 获取最近一次执行的资源使用
      *
      * @param quickjs
-     * @param val
-     * @return true
-     * @return false
+     * @param usage
      */
-    EXPORT bool quickjs_is_exception(QuickJS_t quickjs, JSValue val)
+    EXPORT void quickjs_last_usage(QuickJS_t quickjs, QuickJSEvalUsage *usage)
     {
-        return ((QuickJS *)quickjs)->quickjs_is_exception(val);
+        ((QuickJS *)quickjs)->quickjs_last_usage(usage);
     }
 
     /**
-     * @brief 获取异常信息
+     * @brief 创建一个调用宿主函数的JS函数
      *
      * @param quickjs
-     * @return const char *
+     * @param name 函数名
+     * @param length 参数个数
+     * @param function_id 宿主分发表中的序号
+     * @return QuickJSHandle_t
      */
-    EXPORT const char *quickjs_get_exception(QuickJS_t quickjs)
+    EXPORT QuickJSHandle_t quickjs_new_function(QuickJS_t quickjs, const char *name, int length, int32_t function_id)
     {
-        return ((QuickJS *)quickjs)->quickjs_get_exception();
+        return ((QuickJS *)quickjs)->quickjs_new_function(name, length, function_id);
     }
 
     /**
-     * @brief 释放
+     * @brief 设置宿主回调
      *
      * @param quickjs
+     * @param callback fn(quickjs, function_id, argc, argv): 返回值句柄
      */
-    EXPORT void quickjs_free(QuickJS_t quickjs)
+    EXPORT void quickjs_set_host_callback(QuickJS_t quickjs, QuickJSHostCallback callback)
     {
-        delete static_cast<QuickJS *>(quickjs);
+        ((QuickJS *)quickjs)->quickjs_set_host_callback(callback);
     }
 
     /**
-     * @brief 创建一个JS的undefined值
+     * @brief 宿主函数向JS抛出异常, 只能在宿主回调中调用
      *
      * @param quickjs
-     * @return JSValue
+     * @param message
      */
-    EXPORT JSValue quickjs_new_undefined(QuickJS_t quickjs)
+    EXPORT void quickjs_throw_error(QuickJS_t quickjs, const char *message)
     {
-        return ((QuickJS *)quickjs)->quickjs_new_undefined();
+        ((QuickJS *)quickjs)->quickjs_throw_error(message);
     }
 
     /**
-     * @brief 创建一个JS的null值
+     * @brief 调用JS函数, this 为 undefined
      *
      * @param quickjs
-     * @return JSValue
+     * @param func 函数句柄
+     * @param argc
+     * @param argv 参数句柄
+     * @return QuickJSHandle_t
      */
-    EXPORT JSValue quickjs_new_null(QuickJS_t quickjs)
+    EXPORT QuickJSHandle_t quickjs_call(QuickJS_t quickjs, QuickJSHandle_t func, int argc, const QuickJSHandle_t *argv)
     {
-        return ((QuickJS *)quickjs)->quickjs_new_null();
+        return ((QuickJS *)quickjs)->quickjs_call(func, argc, argv);
     }
 
     /**
-     * @brief 创建一个JS的true值
+     * @brief 多线程批量执行, 全部输入处理完后返回
+     *
+     * 脚本的执行结果须为函数, 对每个输入调用 fn(input, index), 每个线程使用独立的运行时
+     *
+     * @param script 预编译脚本
+     * @param inputs 所有输入 (结构化数据二进制格式) 拼接而成的缓冲区
+     * @param offsets count+1 个偏移, 第i个输入为 [offsets[i], offsets[i+1])
+     * @param count 输入个数
+     * @param threads 线程数, 0 为CPU核数
+     * @param timeout_us 单个输入的超时时间, 0 为不限制
+     * @return QuickJSBatch_t 需调用 quickjs_batch_free 释放
+     */
+    EXPORT QuickJSBatch_t quickjs_batch_run(QuickJSScript_t script, const char *inputs, const size_t *offsets, size_t count, int threads, uint64_t timeout_us)
+    {
+        QuickJSBatch *batch = new QuickJSBatch((const QuickJSScript *)script, inputs, offsets, count, threads, timeout_us);
+        batch->run();
+        return batch;
+    }
+
+    /**
+     * @brief 获取批量执行的结果数量
+     *
+     * @param batch
+     * @return size_t
+     */
+    EXPORT size_t quickjs_batch_count(QuickJSBatch_t batch)
+    {
+        return ((QuickJSBatch *)batch)->count();
+    }
+
+    /**
+     * @brief 获取批量执行的结果
+     *
+     * @param batch
+     * @param index 输入序号
+     * @param len 输出长度
+     * @return const uint8_t* 二进制格式, 归 batch 所有; 该输入执行失败时返回NULL
+     */
+    EXPORT const uint8_t *quickjs_batch_result(QuickJSBatch_t batch, size_t index, size_t *len)
+    {
+        return ((QuickJSBatch *)batch)->result(index, len);
+    }
+
+    /**
+     * @brief 获取批量执行的异常信息
+     *
+     * @param batch
+     * @param index 输入序号
+     * @param buf 调用方缓冲区
+     * @param buf_len
+     * @return size_t 异常信息长度, 执行成功时为0
+     */
+    EXPORT size_t quickjs_batch_error(QuickJSBatch_t batch, size_t index, char *buf, size_t buf_len)
+    {
+        return ((QuickJSBatch *)batch)->error(index, buf, buf_len);
+    }
+
+    /**
+     * @brief 释放批量执行结果
+     *
+     * @param batch
+     */
+    EXPORT void quickjs_batch_free(QuickJSBatch_t batch)
+    {
+        delete (QuickJSBatch *)batch;
+    }
+
+    /**
+     * @brief 执行待执行的任务 (Promise 回调等) 和到期的定时器, 不会阻塞等待
      *
      * @param quickjs
-     * @return JSValue
+     * @param max_jobs 最多执行的个数, 0 为不限制
+     * @param max_us 最长执行时间 (微秒), 0 为不限制
+     * @return int 执行的个数, 出现异常时返回-1
      */
-    EXPORT JSValue quickjs_new_true(QuickJS_t quickjs)
+    EXPORT int quickjs_run_jobs(QuickJS_t quickjs, int max_jobs, uint64_t max_us)
     {
-        return ((QuickJS *)quickjs)->quickjs_new_true();
+        return ((QuickJS *)quickjs)->quickjs_run_jobs(max_jobs, max_us);
     }
 
     /**
-     * @brief 创建一个JS的false值
+     * @brief 查询是否还有待执行的工作
      *
      * @param quickjs
-     * @return JSValue
+     * @return int64_t -1 为没有, 0 为有可以立即执行的任务, 大于0为距下一个定时器到期的微秒数
      */
-    EXPORT JSValue quickjs_new_false(QuickJS_t quickjs)
+    EXPORT int64_t quickjs_pending(QuickJS_t quickjs)
     {
-        return ((QuickJS *)quickjs)->quickjs_new_false();
+        return ((QuickJS *)quickjs)->quickjs_pending();
     }
 
     /**
-     * @brief 创建一个JS的字符串
+     * @brief 获取Promise的状态
      *
      * @param quickjs
-     * @param str
-     * @return JSValue
+     * @param handle
+     * @return int -1 不是 Promise, 0 等待中, 1 已完成, 2 已拒绝
      */
-    EXPORT JSValue quickjs_new_string(QuickJS_t quickjs, const char *str)
+    EXPORT int quickjs_promise_state(QuickJS_t quickjs, QuickJSHandle_t handle)
     {
-        return ((QuickJS *)quickjs)->quickjs_new_string(str);
+        return ((QuickJS *)quickjs)->quickjs_promise_state(handle);
     }
 
     /**
-     * @brief 创建一个JS的int
+     * @brief 等待Promise完成, 会阻塞调用线程
      *
      * @param quickjs
-     * @param val
-     * @return JSValue
+     * @param handle
+     * @param max_us 最长等待时间 (微秒), 0 为不限制
+     * @return QuickJSHandle_t 完成时为结果, 拒绝或超时时为异常
      */
-    EXPORT JSValue quickjs_new_int(QuickJS_t quickjs, int val)
+    EXPORT QuickJSHandle_t quickjs_await(QuickJS_t quickjs, QuickJSHandle_t handle, uint64_t max_us)
     {
-        return ((QuickJS *)quickjs)->quickjs_new_int(val);
+        return ((QuickJS *)quickjs)->quickjs_await(handle, max_us);
     }
 
     /**
-     * @brief 字符串转json对象
+     * @brief 获取累计计数: 执行次数, 分配次数, GC次数, 解析/执行耗时等
      *
      * @param quickjs
-     * @param str
-     * @return JSValue
+     * @param counters
      */
-    EXPORT JSValue quickjs_new_json(QuickJS_t quickjs, const char *str)
+    EXPORT void quickjs_get_counters(QuickJS_t quickjs, QuickJSCounters *counters)
     {
-        return ((QuickJS *)quickjs)->quickjs_str_to_json(str);
+        ((QuickJS *)quickjs)->quickjs_get_counters(counters);
     }
 
     /**
-     * @brief 创建一个JS的double
+     * @brief 清零累计计数
      *
      * @param quickjs
-     * @param val
-     * @return JSValue
      */
-    EXPORT JSValue quickjs_new_double(QuickJS_t quickjs, double val)
+    EXPORT void quickjs_reset_counters(QuickJS_t quickjs)
     {
-        return ((QuickJS *)quickjs)->quickjs_new_double(val);
+        ((QuickJS *)quickjs)->quickjs_reset_counters();
     }
 
     /**
-     * @brief 设置全局变量
+     * @brief 执行GC
      *
      * @param quickjs
-     * @param property_name 变量名
-     * @param value 值
-     * @return int
      */
-    EXPORT int quickjs_set_property_str(QuickJS_t quickjs, const char *property_name, JSValue value)
+    EXPORT void quickjs_run_gc(QuickJS_t quickjs)
     {
-        return ((QuickJS *)quickjs)->quickjs_set_property_str(property_name, value);
+        ((QuickJS *)quickjs)->quickjs_run_gc();
     }
-}
\ No newline at end of file
+}
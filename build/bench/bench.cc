@@ -0,0 +1,593 @@
+// QuickJs 绑定基准测试
+// 编译: ./bench.sh    运行: ./bench [迭代次数] [用例名] [--json]
+// --json 输出可在版本间对比的JSON结果
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+extern "C"
+{
+#include "../os/QuickJs.h"
+}
+
+// 返回总耗时(微秒), 不包含准备数据的时间
+typedef double (*BenchFunc)(int iterations);
+
+struct BenchCase
+{
+    const char *name;
+    BenchFunc func;
+};
+
+static double bench_now()
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 结构化数据测试负载: 1000条记录 + 10000个double
+static const char *bench_payload_js =
+    "var data = {rows: [], values: []};"
+    "for (var i = 0; i < 1000; i++) {"
+    "  data.rows.push({id: i, name: 'item' + i, price: i * 1.5, tags: ['a', 'b'], active: i % 2 == 0});"
+    "}"
+    "for (var i = 0; i < 10000; i++) { data.values.push(i / 3); }";
+
+// 分配密集的负载, 参考 quickjs/tests/microbench.js 中的对象/数组/字符串/闭包用例
+static const char *bench_alloc_js =
+    "var r = 0;"
+    "for (var i = 0; i < 2000; i++) {"
+    "  var o = {x: i, y: [i, i + 1], s: 'k' + i};"
+    "  var f = (function (v) { return function () { return v.x; }; })(o);"
+    "  r += f() + o.s.length + o.y.length;"
+    "}"
+    "var a = []; for (var i = 0; i < 2000; i++) a.push(String(i) + ',');"
+    "r + a.join('').length";
+
+// 批量执行的处理函数, 每个输入约1000次循环
+static const char *bench_batch_js =
+    "(function (x, i) {"
+    "  var s = 0;"
+    "  for (var k = 0; k < 1000; k++) { s += k % (x + 1); }"
+    "  return {x: x, s: s};"
+    "})";
+
+/**
+ * @brief 生成大脚本: 500个函数定义及调用, 约40KB
+ *
+ * @return std::string
+ */
+static std::string bench_large_js()
+{
+    std::string code;
+    for (int i = 0; i < 500; i++)
+    {
+        std::string n = std::to_string(i);
+        code += "function f" + n + "(a, b) { var o = {k: a + " + n + ", v: [b, '" + n + "']}; return o.k + o.v.length; }\n";
+    }
+    code += "var r = 0;";
+    for (int i = 0; i < 500; i++)
+    {
+        code += "r += f" + std::to_string(i) + "(1, 2);";
+    }
+    return code + "r";
+}
+
+/**
+ * @brief 取出 quickjs_eval_to_buffer 结果中的字符串
+ *
+ * @param buf
+ * @param len
+ * @return std::string
+ */
+static std::string bench_buffer_string(const uint8_t *buf, size_t len)
+{
+    // 1字节类型 + 4字节长度
+    return len > 5 ? std::string((const char *)buf + 5, len - 5) : std::string();
+}
+
+//---------------- 测试用例
+
+/**
+ * @brief 每次新建/释放运行时
+ *
+ * @param iterations
+ * @return double
+ */
+static double bench_create_free(int iterations)
+{
+    double start = bench_now();
+    for (int i = 0; i < iterations; i++)
+    {
+        QuickJS_t quickjs = quickjs_create();
+        quickjs_eval(quickjs, "var a = 1;");
+        quickjs_free(quickjs);
+    }
+    return bench_now() - start;
+}
+
+/**
+ * @brief 从运行时池取出/归还
+ *
+ * @param iterations
+ * @return double
+ */
+static double bench_pool_acquire_release(int iterations)
+{
+    QuickJSPool_t pool = quickjs_pool_create(1, 0);
+    double start = bench_now();
+    for (int i = 0; i < iterations; i++)
+    {
+        QuickJS_t quickjs = quickjs_pool_acquire(pool);
+        quickjs_eval(quickjs, "var a = 1;");
+        quickjs_pool_release(pool, quickjs, 0);
+    }
+    double elapsed = bench_now() - start;
+    quickjs_pool_free(pool);
+    return elapsed;
+}
+
+/**
+ * @brief 执行小脚本
+ *
+ * @param iterations
+ * @return double
+ */
+static double bench_eval_small(int iterations)
+{
+    QuickJS_t quickjs = quickjs_create();
+    double start = bench_now();
+    for (int i = 0; i < iterations; i++)
+    {
+        quickjs_release(quickjs, quickjs_eval(quickjs, "1 + 1"));
+    }
+    double elapsed = bench_now() - start;
+    quickjs_free(quickjs);
+    return elapsed;
+}
+
+/**
+ * @brief 执行大脚本(每次重新解析)
+ *
+ * @param iterations
+ * @return double
+ */
+static double bench_eval_large(int iterations)
+{
+    QuickJS_t quickjs = quickjs_create();
+    std::string code = bench_large_js();
+    double start = bench_now();
+    for (int i = 0; i < iterations; i++)
+    {
+        quickjs_release(quickjs, quickjs_eval(quickjs, code.c_str()));
+    }
+    double elapsed = bench_now() - start;
+    quickjs_free(quickjs);
+    return elapsed;
+}
+
+/**
+ * @brief int 往返转换
+ *
+ * @param iterations
+ * @return double
+ */
+static double bench_convert_int(int iterations)
+{
+    QuickJS_t quickjs = quickjs_create();
+    double start = bench_now();
+    for (int i = 0; i < iterations; i++)
+    {
+        QuickJSHandle_t handle = quickjs_new_int(quickjs, i);
+        quickjs_js_ToInt(quickjs, handle);
+        quickjs_release(quickjs, handle);
+    }
+    double elapsed = bench_now() - start;
+    quickjs_free(quickjs);
+    return elapsed;
+}
+
+/**
+ * @brief 字符串往返转换
+ *
+ * @param iterations
+ * @return double
+ */
+static double bench_convert_string(int iterations)
+{
+    QuickJS_t quickjs = quickjs_create();
+    char buf[64];
+    double start = bench_now();
+    for (int i = 0; i < iterations; i++)
+    {
+        QuickJSHandle_t handle = quickjs_new_string(quickjs, "hello quickjs");
+        quickjs_js_ToCString(quickjs, handle, buf, sizeof(buf));
+        quickjs_release(quickjs, handle);
+    }
+    double elapsed = bench_now() - start;
+    quickjs_free(quickjs);
+    return elapsed;
+}
+
+/**
+ * @brief 结构化数据 + 10000个循环引用对象常驻时的完整GC停顿
+ *
+ * @param iterations
+ * @return double
+ */
+static double bench_gc_pause(int iterations)
+{
+    QuickJS_t quickjs = quickjs_create();
+    quickjs_eval(quickjs, bench_payload_js);
+    quickjs_eval(quickjs, "var ring = []; for (var i = 0; i < 10000; i++) { var o = {i: i}; o.self = o; ring.push(o); }");
+    double start = bench_now();
+    for (int i = 0; i < iterations; i++)
+    {
+        quickjs_run_gc(quickjs);
+    }
+    double elapsed = bench_now() - start;
+    quickjs_free(quickjs);
+    return elapsed;
+}
+
+/**
+ * @brief JSON 文本传入JS: quickjs_new_json 后释放, 与 bench.php 的 newJson 相同
+ *
+ * @param iterations
+ * @return double
+ */
+static double bench_json_ingress(int iterations)
+{
+    QuickJS_t quickjs = quickjs_create();
+    quickjs_eval(quickjs, bench_payload_js);
+    size_t len;
+    const uint8_t *buf = quickjs_eval_to_buffer(quickjs, "JSON.stringify(data)", &len);
+    std::string json = bench_buffer_string(buf, len);
+
+    double start = bench_now();
+    for (int i = 0; i < iterations; i++)
+    {
+        quickjs_release(quickjs, quickjs_new_json(quickjs, json.c_str()));
+    }
+    double elapsed = bench_now() - start;
+    quickjs_free(quickjs);
+    return elapsed;
+}
+
+/**
+ * @brief 二进制缓冲区传入JS
+ *
+ * @param iterations
+ * @return double
+ */
+static double bench_buffer_ingress(int iterations)
+{
+    QuickJS_t quickjs = quickjs_create();
+    quickjs_eval(quickjs, bench_payload_js);
+    size_t len;
+    const uint8_t *buf = quickjs_eval_to_buffer(quickjs, "data", &len);
+    std::string payload((const char *)buf, len);
+
+    double start = bench_now();
+    for (int i = 0; i < iterations; i++)
+    {
+        QuickJSHandle_t data = quickjs_new_from_buffer(quickjs, payload.data(), payload.size());
+        quickjs_set_property_str(quickjs, "data", data);
+        quickjs_release(quickjs, data);
+    }
+    double elapsed = bench_now() - start;
+    quickjs_free(quickjs);
+    return elapsed;
+}
+
+/**
+ * @brief JS 结果以 JSON 文本取回: 执行 JSON.stringify, 复制字符串后释放, 与 bench.php 的 eval + toString 相同
+ *
+ * @param iterations
+ * @return double
+ */
+static double bench_json_egress(int iterations)
+{
+    QuickJS_t quickjs = quickjs_create();
+    quickjs_eval(quickjs, bench_payload_js);
+    QuickJSHandle_t handle = quickjs_eval(quickjs, "JSON.stringify(data)");
+    std::vector<char> buf(quickjs_js_ToCString(quickjs, handle, NULL, 0) + 1);
+    quickjs_release(quickjs, handle);
+    double start = bench_now();
+    for (int i = 0; i < iterations; i++)
+    {
+        handle = quickjs_eval(quickjs, "JSON.stringify(data)");
+        quickjs_js_ToCString(quickjs, handle, buf.data(), buf.size());
+        quickjs_release(quickjs, handle);
+    }
+    double elapsed = bench_now() - start;
+    quickjs_free(quickjs);
+    return elapsed;
+}
+
+/**
+ * @brief JS 结果以二进制缓冲区取回
+ *
+ * @param iterations
+ * @return double
+ */
+static double bench_buffer_egress(int iterations)
+{
+    QuickJS_t quickjs = quickjs_create();
+    quickjs_eval(quickjs, bench_payload_js);
+    size_t len;
+    double start = bench_now();
+    for (int i = 0; i < iterations; i++)
+    {
+        quickjs_eval_to_buffer(quickjs, "data", &len);
+    }
+    double elapsed = bench_now() - start;
+    quickjs_free(quickjs);
+    return elapsed;
+}
+
+/**
+ * @brief 10000个double以零拷贝类型化数组传入JS
+ *
+ * @param iterations
+ * @return double
+ */
+static double bench_typed_array_ingress(int iterations)
+{
+    QuickJS_t quickjs = quickjs_create();
+    static double values[10000];
+    for (int i = 0; i < 10000; i++)
+    {
+        values[i] = i / 3.0;
+    }
+    double start = bench_now();
+    for (int i = 0; i < iterations; i++)
+    {
+        QuickJSHandle_t array = quickjs_new_typed_array(quickjs, values, 10000, 11, 0);
+        quickjs_set_property_str(quickjs, "values", array);
+        quickjs_release(quickjs, array);
+    }
+    double elapsed = bench_now() - start;
+    quickjs_free(quickjs);
+    return elapsed;
+}
+
+/**
+ * @brief 默认分配器: 创建运行时, 执行分配密集的负载, 释放
+ *
+ * @param iterations
+ * @return double
+ */
+static double bench_alloc_default(int iterations)
+{
+    double start = bench_now();
+    for (int i = 0; i < iterations; i++)
+    {
+        QuickJS_t quickjs = quickjs_create();
+        quickjs_eval(quickjs, bench_alloc_js);
+        quickjs_free(quickjs);
+    }
+    return bench_now() - start;
+}
+
+/**
+ * @brief 专用分配器: 同 bench_alloc_default
+ *
+ * @param iterations
+ * @return double
+ */
+static double bench_alloc_arena(int iterations)
+{
+    double start = bench_now();
+    for (int i = 0; i < iterations; i++)
+    {
+        QuickJS_t quickjs = quickjs_create_arena(0);
+        quickjs_eval(quickjs, bench_alloc_js);
+        quickjs_free(quickjs);
+    }
+    return bench_now() - start;
+}
+
+/**
+ * @brief 宿主函数: 两个参数相加
+ */
+static QuickJSHandle_t bench_host_add(QuickJS_t quickjs, int32_t function_id, int argc, const QuickJSHandle_t *argv)
+{
+    return quickjs_new_int(quickjs, quickjs_js_ToInt(quickjs, argv[0]) + quickjs_js_ToInt(quickjs, argv[1]));
+}
+
+/**
+ * @brief 在一次执行中循环调用 add, 每次迭代为一次调用
+ *
+ * @param iterations
+ * @param host 为true时 add 为宿主函数, 否则为JS函数 (对照)
+ * @return double
+ */
+static double bench_call(int iterations, bool host)
+{
+    QuickJS_t quickjs = quickjs_create();
+    QuickJSHandle_t func;
+    if (host)
+    {
+        quickjs_set_host_callback(quickjs, bench_host_add);
+        func = quickjs_new_function(quickjs, "add", 2, 0);
+    }
+    else
+    {
+        func = quickjs_eval(quickjs, "(function add(a, b) { return a + b; })");
+    }
+    quickjs_set_property_str(quickjs, "add", func);
+    quickjs_release(quickjs, func);
+    std::string code = "var r = 0; for (var i = 0; i < " + std::to_string(iterations) + "; i++) { r = add(i, r) & 0xffff; }";
+
+    double start = bench_now();
+    quickjs_release(quickjs, quickjs_eval(quickjs, code.c_str()));
+    double elapsed = bench_now() - start;
+    quickjs_free(quickjs);
+    return elapsed;
+}
+
+/**
+ * @brief JS调用宿主函数
+ */
+static double bench_host_call(int iterations)
+{
+    return bench_call(iterations, true);
+}
+
+/**
+ * @brief JS调用JS函数 (对照)
+ */
+static double bench_js_call(int iterations)
+{
+    return bench_call(iterations, false);
+}
+
+/**
+ * @brief 批量执行, 每次迭代为一个输入
+ *
+ * @param iterations
+ * @param threads 线程数, 0 为CPU核数
+ * @return double
+ */
+static double bench_batch(int iterations, int threads)
+{
+    QuickJS_t quickjs = quickjs_create();
+    QuickJSScript_t script = quickjs_compile(quickjs, bench_batch_js, NULL);
+    // 输入为int: 1字节类型 + 4字节值
+    std::string inputs;
+    std::vector<size_t> offsets{0};
+    for (int32_t i = 0; i < iterations; i++)
+    {
+        inputs.push_back(4);
+        inputs.append((const char *)&i, 4);
+        offsets.push_back(inputs.size());
+    }
+
+    double start = bench_now();
+    QuickJSBatch_t batch = quickjs_batch_run(script, inputs.data(), offsets.data(), iterations, threads, 0);
+    double elapsed = bench_now() - start;
+    quickjs_batch_free(batch);
+    quickjs_script_free(script);
+    quickjs_free(quickjs);
+    return elapsed;
+}
+
+/**
+ * @brief 单线程批量执行
+ */
+static double bench_batch_single(int iterations)
+{
+    return bench_batch(iterations, 1);
+}
+
+/**
+ * @brief 每个CPU核一个线程批量执行
+ */
+static double bench_batch_cores(int iterations)
+{
+    return bench_batch(iterations, 0);
+}
+
+/**
+ * @brief 异步函数中循环 await, 由 quickjs_await 驱动, 每次迭代为一次 await
+ */
+static double bench_promise_await(int iterations)
+{
+    QuickJS_t quickjs = quickjs_create();
+    std::string code = "(async () => { var r = 0; for (var i = 0; i < " + std::to_string(iterations) + "; i++) { r += await i; } return r; })()";
+
+    double start = bench_now();
+    QuickJSHandle_t promise = quickjs_eval(quickjs, code.c_str());
+    QuickJSHandle_t result = quickjs_await(quickjs, promise, 0);
+    double elapsed = bench_now() - start;
+    quickjs_release(quickjs, result);
+    quickjs_release(quickjs, promise);
+    quickjs_free(quickjs);
+    return elapsed;
+}
+
+static const BenchCase bench_cases[] = {
+    {"create_free", bench_create_free},
+    {"pool_acquire_release", bench_pool_acquire_release},
+    {"eval_small", bench_eval_small},
+    {"eval_large", bench_eval_large},
+    {"convert_int", bench_convert_int},
+    {"convert_string", bench_convert_string},
+    {"json_ingress", bench_json_ingress},
+    {"buffer_ingress", bench_buffer_ingress},
+    {"json_egress", bench_json_egress},
+    {"buffer_egress", bench_buffer_egress},
+    {"typed_array_ingress", bench_typed_array_ingress},
+    {"alloc_default", bench_alloc_default},
+    {"alloc_arena", bench_alloc_arena},
+    {"host_call", bench_host_call},
+    {"js_call", bench_js_call},
+    {"batch_single", bench_batch_single},
+    {"batch_cores", bench_batch_cores},
+    {"promise_await", bench_promise_await},
+    {"gc_pause", bench_gc_pause},
+};
+
+int main(int argc, char **argv)
+{
+    int iterations = 1000;
+    const char *filter = NULL;
+    bool json = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--json") == 0)
+        {
+            json = true;
+        }
+        else if (argv[i][0] >= '0' && argv[i][0] <= '9')
+        {
+            iterations = atoi(argv[i]);
+        }
+        else
+        {
+            filter = argv[i];
+        }
+    }
+    if (iterations <= 0)
+    {
+        iterations = 1000;
+    }
+
+    if (json)
+    {
+        printf("{\"driver\": \"c++\", \"iterations\": %d, \"cases\": [", iterations);
+    }
+    else
+    {
+        printf("%-28s %12s %14s %14s\n", "case", "iterations", "avg(us)", "ops/s");
+    }
+    bool first = true;
+    for (const BenchCase &bench : bench_cases)
+    {
+        if (filter && strcmp(filter, bench.name) != 0)
+        {
+            continue;
+        }
+        double elapsed = bench.func(iterations);
+        if (json)
+        {
+            printf("%s\n  {\"name\": \"%s\", \"iterations\": %d, \"avg_us\": %.3f, \"ops_per_sec\": %.0f}",
+                   first ? "" : ",", bench.name, iterations, elapsed / iterations, iterations * 1e6 / elapsed);
+        }
+        else
+        {
+            printf("%-28s %12d %14.3f %14.0f\n", bench.name, iterations, elapsed / iterations, iterations * 1e6 / elapsed);
+        }
+        first = false;
+    }
+    if (json)
+    {
+        printf("\n]}\n");
+    }
+    return 0;
+}
@@ -0,0 +1,205 @@
+<?php
+
+// QuickJs PHP 绑定基准测试, 包含 FFI 调用开销
+// 运行: php bench.php [迭代次数] [用例名] [--json]
+// --json 输出与 ./bench 相同格式的JSON结果
+
+// 严格模式
+declare(strict_types=1);
+
+require_once dirname(__DIR__, 2) . DIRECTORY_SEPARATOR . "src" . DIRECTORY_SEPARATOR . "QuickJs.php";
+
+use Bunny\QuickJs\QuickJs;
+
+// 结构化数据测试负载: 1000条记录 + 10000个double, 与 bench.cc 一致
+const BENCH_PAYLOAD_JS = "var data = {rows: [], values: []};"
+    . "for (var i = 0; i < 1000; i++) {"
+    . "  data.rows.push({id: i, name: 'item' + i, price: i * 1.5, tags: ['a', 'b'], active: i % 2 == 0});"
+    . "}"
+    . "for (var i = 0; i < 10000; i++) { data.values.push(i / 3); }";
+
+/**
+ * 生成大脚本, 与 bench.cc 一致 function
+ *
+ * @return string
+ */
+function bench_large_js(): string
+{
+    $code = "";
+    for ($i = 0; $i < 500; $i++) {
+        $code .= "function f{$i}(a, b) { var o = {k: a + {$i}, v: [b, '{$i}']}; return o.k + o.v.length; }\n";
+    }
+    $code .= "var r = 0;";
+    for ($i = 0; $i < 500; $i++) {
+        $code .= "r += f{$i}(1, 2);";
+    }
+    return $code . "r";
+}
+
+/**
+ * 在新运行时中计时 function
+ *
+ * @param QuickJs $quick_js
+ * @param integer $iterations
+ * @param string $setup 计时前执行的代码
+ * @param callable $fn fn(\FFI\CData $run_time, int $i): void
+ * @return float 总耗时(微秒)
+ */
+function bench_run(QuickJs $quick_js, int $iterations, string $setup, callable $fn): float
+{
+    $run_time = $quick_js->create();
+    if ($setup !== "") {
+        $quick_js->release($run_time, $quick_js->eval($run_time, $setup));
+    }
+    $start = hrtime(true);
+    for ($i = 0; $i < $iterations; $i++) {
+        $fn($run_time, $i);
+    }
+    $elapsed = (hrtime(true) - $start) / 1000;
+    $quick_js->free($run_time);
+    return $elapsed;
+}
+
+/**
+ * 在一次执行中循环调用 add, 每次迭代为一次调用, 与 bench.cc 一致 function
+ *
+ * @param QuickJs $quick_js
+ * @param integer $iterations
+ * @param boolean $host 为true时 add 为PHP函数, 否则为JS函数 (对照)
+ * @return float 总耗时(微秒)
+ */
+function bench_call(QuickJs $quick_js, int $iterations, bool $host): float
+{
+    $run_time = $quick_js->create();
+    if ($host) {
+        $quick_js->setFunction($run_time, "add", fn (\FFI\CData $run_time, int $a, int $b): int =>
+            $quick_js->newInt($run_time, $quick_js->toInt($run_time, $a) + $quick_js->toInt($run_time, $b)), 2);
+    } else {
+        $quick_js->release($run_time, $quick_js->eval($run_time, "var add = function add(a, b) { return a + b; }"));
+    }
+    $code = "var r = 0; for (var i = 0; i < {$iterations}; i++) { r = add(i, r) & 0xffff; }";
+    $start = hrtime(true);
+    $quick_js->release($run_time, $quick_js->eval($run_time, $code));
+    $elapsed = (hrtime(true) - $start) / 1000;
+    $quick_js->free($run_time);
+    return $elapsed;
+}
+
+$quick_js = new QuickJs();
+$large_js = bench_large_js();
+
+// 返回总耗时(微秒), 不包含准备数据的时间
+// 与 bench.cc 同名的用例调用相同的C接口序列; convert_value、value_egress、call_roundtrip 只在PHP中测量
+$bench_cases = [
+    "create_free" => function (int $iterations) use ($quick_js): float {
+        $start = hrtime(true);
+        for ($i = 0; $i < $iterations; $i++) {
+            $run_time = $quick_js->create();
+            $quick_js->eval($run_time, "var a = 1;");
+            $quick_js->free($run_time);
+        }
+        return (hrtime(true) - $start) / 1000;
+    },
+    "eval_small" => fn (int $iterations): float => bench_run($quick_js, $iterations, "", function ($run_time) use ($quick_js) {
+        $quick_js->release($run_time, $quick_js->eval($run_time, "1 + 1"));
+    }),
+    "eval_large" => fn (int $iterations): float => bench_run($quick_js, $iterations, "", function ($run_time) use ($quick_js, $large_js) {
+        $quick_js->release($run_time, $quick_js->eval($run_time, $large_js));
+    }),
+    "convert_int" => fn (int $iterations): float => bench_run($quick_js, $iterations, "", function ($run_time, $i) use ($quick_js) {
+        $js_obj = $quick_js->newInt($run_time, $i);
+        $quick_js->toInt($run_time, $js_obj);
+        $quick_js->release($run_time, $js_obj);
+    }),
+    "convert_string" => fn (int $iterations): float => bench_run($quick_js, $iterations, "", function ($run_time) use ($quick_js) {
+        $js_obj = $quick_js->newString($run_time, "hello quickjs");
+        $quick_js->toString($run_time, $js_obj);
+        $quick_js->release($run_time, $js_obj);
+    }),
+    "convert_value" => fn (int $iterations): float => bench_run($quick_js, $iterations, "", function ($run_time, $i) use ($quick_js) {
+        $js_obj = $quick_js->newValue($run_time, ["id" => $i, "name" => "item", "tags" => ["a", "b"]]);
+        $quick_js->toValue($run_time, $js_obj);
+        $quick_js->release($run_time, $js_obj);
+    }),
+    "json_ingress" => function (int $iterations) use ($quick_js): float {
+        $run_time = $quick_js->create();
+        $quick_js->eval($run_time, BENCH_PAYLOAD_JS);
+        $json = $quick_js->toString($run_time, $quick_js->eval($run_time, "JSON.stringify(data)"));
+        $quick_js->free($run_time);
+        return bench_run($quick_js, $iterations, BENCH_PAYLOAD_JS, function ($run_time) use ($quick_js, $json) {
+            $quick_js->release($run_time, $quick_js->newJson($run_time, $json));
+        });
+    },
+    "json_egress" => fn (int $iterations): float => bench_run($quick_js, $iterations, BENCH_PAYLOAD_JS, function ($run_time) use ($quick_js) {
+        $js_obj = $quick_js->eval($run_time, "JSON.stringify(data)");
+        $quick_js->toString($run_time, $js_obj);
+        $quick_js->release($run_time, $js_obj);
+    }),
+    "value_egress" => fn (int $iterations): float => bench_run($quick_js, $iterations, BENCH_PAYLOAD_JS, function ($run_time) use ($quick_js) {
+        $quick_js->evalValue($run_time, "data");
+    }),
+    "host_call" => fn (int $iterations): float => bench_call($quick_js, $iterations, true),
+    "js_call" => fn (int $iterations): float => bench_call($quick_js, $iterations, false),
+    // PHP 调用 JS 中的 PHP 函数: call 的 FFI 往返 + 宿主回调
+    "call_roundtrip" => function (int $iterations) use ($quick_js): float {
+        $run_time = $quick_js->create();
+        $fn = $quick_js->newFunction($run_time, fn ($run_time, int ...$args): ?int => null);
+        $arg = $quick_js->newInt($run_time, 1);
+        $start = hrtime(true);
+        for ($i = 0; $i < $iterations; $i++) {
+            $quick_js->release($run_time, $quick_js->call($run_time, $fn, $arg));
+        }
+        $elapsed = (hrtime(true) - $start) / 1000;
+        $quick_js->free($run_time);
+        return $elapsed;
+    },
+    "gc_pause" => fn (int $iterations): float => bench_run(
+        $quick_js,
+        $iterations,
+        BENCH_PAYLOAD_JS . ";var ring = []; for (var i = 0; i < 10000; i++) { var o = {i: i}; o.self = o; ring.push(o); }",
+        function ($run_time) use ($quick_js) {
+            $quick_js->runGc($run_time);
+        }
+    ),
+];
+
+$iterations = 1000;
+$filter = null;
+$json = false;
+foreach (array_slice($argv, 1) as $arg) {
+    if ($arg === "--json") {
+        $json = true;
+    } elseif (ctype_digit($arg)) {
+        $iterations = (int)$arg;
+    } else {
+        $filter = $arg;
+    }
+}
+if ($iterations <= 0) {
+    $iterations = 1000;
+}
+
+$results = [];
+if (!$json) {
+    printf("%-28s %12s %14s %14s\n", "case", "iterations", "avg(us)", "ops/s");
+}
+foreach ($bench_cases as $name => $bench) {
+    if ($filter !== null && $filter !== $name) {
+        continue;
+    }
+    $elapsed = $bench($iterations);
+    $result = [
+        "name" => $name,
+        "iterations" => $iterations,
+        "avg_us" => round($elapsed / $iterations, 3),
+        "ops_per_sec" => round($iterations * 1e6 / $elapsed),
+    ];
+    if ($json) {
+        $results[] = $result;
+    } else {
+        printf("%-28s %12d %14.3f %14.0f\n", $name, $iterations, $result["avg_us"], $result["ops_per_sec"]);
+    }
+}
+if ($json) {
+    echo json_encode(["driver" => "php", "iterations" => $iterations, "cases" => $results], JSON_PRETTY_PRINT), PHP_EOL;
+}
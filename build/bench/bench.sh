@@ -0,0 +1 @@
+g++ -O2 bench.cc -o ./bench -L../os -l:QuickJs.so -Wl,-rpath,'$ORIGIN/../os' -lm -ldl -lpthread
@@ -25,43 +25,178 @@ typedef enum JSErrorEnum
     JS_NATIVE_ERROR_COUNT, /* number of different NativeError objects */
 } JSErrorEnum;
 
+// 专用分配器统计
+typedef struct QuickJSAllocStats
+{
+    size_t peak;          // 峰值使用字节
+    size_t used;          // 当前使用字节
+    size_t reserved;      // 向系统申请的字节 (arena + 大块)
+    size_t free_list;     // 空闲链表中的字节
+    size_t arena_count;   // arena 数量
+    size_t large_count;   // 当前大块数量
+    size_t alloc_count;   // 累计分配次数
+    double fragmentation; // 1 - used / reserved
+} QuickJSAllocStats;
+
+// 最近一次执行的资源使用
+typedef struct QuickJSEvalUsage
+{
+    uint64_t elapsed_us;      // 执行耗时 (微秒)
+    int64_t malloc_size;      // 执行后已分配字节, 未开启内存统计时为-1
+    int64_t malloc_delta;     // 执行前后已分配字节的变化
+    int64_t malloc_count;     // 执行后已分配块数
+    int64_t memory_used_size; // 执行后运行时内部对象占用字节
+    int32_t interrupted;      // 是否因超时被中断
+    int32_t reserved;
+} QuickJSEvalUsage;
+
+// 运行时累计计数
+typedef struct QuickJSCounters
+{
+    uint64_t evals;       // 执行次数 (eval/run_compiled/call/eval_to_buffer)
+    uint64_t allocations; // 分配次数 (含 realloc)
+    uint64_t gc_runs;     // GC次数, 包括自动触发的GC
+    uint64_t parse_us;    // 解析耗时 (微秒), 包括 quickjs_compile
+    uint64_t execute_us;  // 执行耗时 (微秒), 包括任务和定时器
+    uint64_t host_calls;  // 宿主函数调用次数
+    uint64_t jobs;        // 执行的任务和定时器个数
+} QuickJSCounters;
+
 typedef void *QuickJS_t;
+// JS值句柄, 用完需调用 quickjs_release 释放
+typedef int64_t QuickJSHandle_t;
+typedef void *QuickJSScript_t;
+typedef void *QuickJSPool_t;
+typedef void *QuickJSBatch_t;
+// 宿主回调, 所有宿主函数通过它按 function_id 分发; 参数句柄在返回后自动释放, 返回值句柄交给运行时 (0 为 undefined)
+typedef QuickJSHandle_t (*QuickJSHostCallback)(QuickJS_t quickjs, int32_t function_id, int argc, const QuickJSHandle_t *argv);
 // 创建
 QuickJS_t quickjs_create();
 // 释放
 void quickjs_free(QuickJS_t quickjs);
 // 执行js代码
-JSValue quickjs_eval(QuickJS_t quickjs, const char *js_code);
+QuickJSHandle_t quickjs_eval(QuickJS_t quickjs, const char *js_code);
 // 判断是否是异常
-bool quickjs_is_exception(QuickJS_t quickjs, JSValue val);
+bool quickjs_is_exception(QuickJS_t quickjs, QuickJSHandle_t handle);
 // 获取异常信息
-const char *quickjs_get_exception(QuickJS_t quickjs);
+size_t quickjs_get_exception(QuickJS_t quickjs, char *buf, size_t buf_len);
 // 转字符串
-const char *quickjs_js_ToCString(QuickJS_t quickjs, JSValue val);
+size_t quickjs_js_ToCString(QuickJS_t quickjs, QuickJSHandle_t handle, char *buf, size_t buf_len);
 // 转bool
-bool quickjs_js_ToBool(QuickJS_t quickjs, JSValue val);
+bool quickjs_js_ToBool(QuickJS_t quickjs, QuickJSHandle_t handle);
 // 转int
-int quickjs_js_ToInt(QuickJS_t quickjs, JSValue val);
+int quickjs_js_ToInt(QuickJS_t quickjs, QuickJSHandle_t handle);
 // 创建一个JS的undefined值
-JSValue quickjs_new_undefined(QuickJS_t quickjs);
+QuickJSHandle_t quickjs_new_undefined(QuickJS_t quickjs);
 // 创建一个JS的null值
-JSValue quickjs_new_null(QuickJS_t quickjs);
+QuickJSHandle_t quickjs_new_null(QuickJS_t quickjs);
 // 创建一个JS的true值
-JSValue quickjs_new_true(QuickJS_t quickjs);
+QuickJSHandle_t quickjs_new_true(QuickJS_t quickjs);
 // 创建一个JS的false值
-JSValue quickjs_new_false(QuickJS_t quickjs);
+QuickJSHandle_t quickjs_new_false(QuickJS_t quickjs);
 // 创建一个JS的字符串
-JSValue quickjs_new_string(QuickJS_t quickjs, const char *str);
+QuickJSHandle_t quickjs_new_string(QuickJS_t quickjs, const char *str);
 // 创建一个JS的int
-JSValue quickjs_new_int(QuickJS_t quickjs, int val);
+QuickJSHandle_t quickjs_new_int(QuickJS_t quickjs, int val);
 // 创建一个JS的json对象
-JSValue quickjs_new_json(QuickJS_t quickjs, const char *str);
+QuickJSHandle_t quickjs_new_json(QuickJS_t quickjs, const char *str);
 // 创建一个JS的double
-JSValue quickjs_new_double(QuickJS_t quickjs, double val);
-// 创建一个JS的函数
-JSValue quickjs_new_function(QuickJS_t quickjs,
-                             const char *name,
-                             int length,
-                             JSValue (*func)(JSValue this_val, int argc, JSValue *argv));
+QuickJSHandle_t quickjs_new_double(QuickJS_t quickjs, double val);
 // 设置全局变量
-int quickjs_set_property_str(QuickJS_t quickjs, const char *property_name, JSValue value);
\ No newline at end of file
+int quickjs_set_property_str(QuickJS_t quickjs, const char *property_name, QuickJSHandle_t handle);
+// 编译js代码为字节码, 缓存目录须为当前用户所有且组和其他用户不可写
+QuickJSScript_t quickjs_compile(QuickJS_t quickjs, const char *js_code, const char *cache_dir);
+// 执行预编译的字节码
+QuickJSHandle_t quickjs_run_compiled(QuickJS_t quickjs, QuickJSScript_t script);
+// 从字节码创建预编译脚本, 字节码不做校验, 只能加载可信数据
+QuickJSScript_t quickjs_script_load(const char *buf, size_t len);
+// 获取字节码
+const uint8_t *quickjs_script_bytecode(QuickJSScript_t script);
+// 获取字节码长度
+size_t quickjs_script_size(QuickJSScript_t script);
+// 释放预编译脚本
+void quickjs_script_free(QuickJSScript_t script);
+// 清空进程内字节码缓存
+void quickjs_script_cache_clear();
+// 重置运行时
+int quickjs_reset(QuickJS_t quickjs);
+// 创建运行时池
+QuickJSPool_t quickjs_pool_create(int size, int max_uses);
+// 从池中取出运行时
+QuickJS_t quickjs_pool_acquire(QuickJSPool_t pool);
+// 归还运行时
+void quickjs_pool_release(QuickJSPool_t pool, QuickJS_t quickjs, int discard);
+// 释放运行时池
+void quickjs_pool_free(QuickJSPool_t pool);
+// 获取进程级运行时池
+QuickJSPool_t quickjs_pool_global(int size, int max_uses);
+// 记录内置对象, 重置时一并还原
+void quickjs_track_builtins(QuickJS_t quickjs);
+// 创建类型化数组, type: 9:Uint8Array 10:Int32Array 11:Float64Array
+QuickJSHandle_t quickjs_new_typed_array(QuickJS_t quickjs, void *data, size_t count, int type, int copy);
+// 从二进制缓冲区创建JS值
+QuickJSHandle_t quickjs_new_from_buffer(QuickJS_t quickjs, const char *buf, size_t len);
+// 将JS值写入二进制缓冲区
+const uint8_t *quickjs_to_buffer(QuickJS_t quickjs, QuickJSHandle_t handle, size_t *len);
+// 执行js代码并将结果写入二进制缓冲区
+const uint8_t *quickjs_eval_to_buffer(QuickJS_t quickjs, const char *js_code, size_t *len);
+// 释放句柄
+int quickjs_release(QuickJS_t quickjs, QuickJSHandle_t handle);
+// 批量释放句柄
+int quickjs_release_batch(QuickJS_t quickjs, const QuickJSHandle_t *handles, int count);
+// 释放所有句柄
+void quickjs_release_all(QuickJS_t quickjs);
+// 开关调试模式
+void quickjs_set_debug(QuickJS_t quickjs, int enable);
+// 获取存活的句柄数量
+int quickjs_handle_count(QuickJS_t quickjs);
+// 获取调试报告
+size_t quickjs_debug_report(QuickJS_t quickjs, char *buf, size_t buf_len);
+// 使用专用分配器创建
+QuickJS_t quickjs_create_arena(size_t chunk_size);
+// 获取专用分配器统计
+int quickjs_alloc_stats(QuickJS_t quickjs, QuickJSAllocStats *stats);
+// 设置内存上限
+void quickjs_set_memory_limit(QuickJS_t quickjs, size_t limit);
+// 设置最大栈深度
+void quickjs_set_max_stack_size(QuickJS_t quickjs, size_t stack_size);
+// 设置自动GC阈值
+void quickjs_set_gc_threshold(QuickJS_t quickjs, size_t gc_threshold);
+// 设置单次执行超时
+void quickjs_set_timeout(QuickJS_t quickjs, uint64_t timeout_us, uint32_t check_interval);
+// 开关内存统计
+void quickjs_set_usage_tracking(QuickJS_t quickjs, int enable);
+// 获取最近一次执行的资源使用
+void quickjs_last_usage(QuickJS_t quickjs, QuickJSEvalUsage *usage);
+// 创建一个调用宿主函数的JS函数
+QuickJSHandle_t quickjs_new_function(QuickJS_t quickjs, const char *name, int length, int32_t function_id);
+// 设置宿主回调
+void quickjs_set_host_callback(QuickJS_t quickjs, QuickJSHostCallback callback);
+// 宿主函数向JS抛出异常
+void quickjs_throw_error(QuickJS_t quickjs, const char *message);
+// 调用JS函数
+QuickJSHandle_t quickjs_call(QuickJS_t quickjs, QuickJSHandle_t func, int argc, const QuickJSHandle_t *argv);
+// 多线程批量执行
+QuickJSBatch_t quickjs_batch_run(QuickJSScript_t script, const char *inputs, const size_t *offsets, size_t count, int threads, uint64_t timeout_us);
+// 获取批量执行的结果数量
+size_t quickjs_batch_count(QuickJSBatch_t batch);
+// 获取批量执行的结果
+const uint8_t *quickjs_batch_result(QuickJSBatch_t batch, size_t index, size_t *len);
+// 获取批量执行的异常信息
+size_t quickjs_batch_error(QuickJSBatch_t batch, size_t index, char *buf, size_t buf_len);
+// 释放批量执行结果
+void quickjs_batch_free(QuickJSBatch_t batch);
+// 执行待执行的任务和到期的定时器
+int quickjs_run_jobs(QuickJS_t quickjs, int max_jobs, uint64_t max_us);
+// 查询是否还有待执行的工作
+int64_t quickjs_pending(QuickJS_t quickjs);
+// 获取Promise的状态
+int quickjs_promise_state(QuickJS_t quickjs, QuickJSHandle_t handle);
+// 等待Promise完成
+QuickJSHandle_t quickjs_await(QuickJS_t quickjs, QuickJSHandle_t handle, uint64_t max_us);
+// 获取累计计数
+void quickjs_get_counters(QuickJS_t quickjs, QuickJSCounters *counters);
+// 清零累计计数
+void quickjs_reset_counters(QuickJS_t quickjs);
+// 执行GC
+void quickjs_run_gc(QuickJS_t quickjs);
@@ -10,6 +10,20 @@ namespace Bunny\QuickJs;
  */
 class QuickJs
 {
+    /**
+     * 类型化数组类型, 与二进制格式中的类型一致
+     */
+    public const TYPED_UINT8 = 9;
+    public const TYPED_INT32 = 10;
+    public const TYPED_FLOAT64 = 11;
+
+    /**
+     * Promise状态
+     */
+    public const PROMISE_PENDING = 0;
+    public const PROMISE_FULFILLED = 1;
+    public const PROMISE_REJECTED = 2;
+
     /**
      * FFI variable
      *
@@ -17,6 +31,48 @@ class QuickJs
      */
     protected \FFI $ffi;
 
+    /**
+     * 字符串缓冲区, 不够时自动扩容
+     *
+     * @var \FFI\CData|null
+     */
+    protected ?\FFI\CData $buffer = null;
+
+    /**
+     * 宿主函数分发表, 以 function_id 为键
+     *
+     * @var callable[]
+     */
+    protected array $functions = [];
+
+    /**
+     * 各运行时注册的 function_id, 以运行时地址为键
+     *
+     * @var bool[][]
+     */
+    protected array $functionIds = [];
+
+    /**
+     * 各运行时 setFunction 设置的全局函数, 以运行时地址和函数名为键
+     *
+     * @var int[][]
+     */
+    protected array $functionNames = [];
+
+    /**
+     * 下一个 function_id, 移除后不复用
+     *
+     * @var integer
+     */
+    protected int $nextFunctionId = 0;
+
+    /**
+     * 宿主回调函数指针, 所有运行时共用一个
+     *
+     * @var \FFI\CData|null
+     */
+    protected ?\FFI\CData $callback = null;
+
     /**
      * 构造 function
      *
@@ -59,9 +115,9 @@ class QuickJs
      *
      * @param \FFI\CData $run_time JS运行时对象
      * @param string $code JS代码
-     * @return \FFI\CData 结果对象
+     * @return integer JS值句柄
      */
-    public function eval(\FFI\CData $run_time, string $code): \FFI\CData
+    public function eval(\FFI\CData $run_time, string $code): int
     {
         return $this->ffi->quickjs_eval($run_time, $code);
     }
@@ -70,10 +126,10 @@ class QuickJs
      * 是否是异常 function
      *
      * @param \FFI\CData $run_time JS运行时对象
-     * @param \FFI\CData $js_eval JS对象
+     * @param integer $js_eval JS值句柄
      * @return boolean
      */
-    public function isException(\FFI\CData $run_time, \FFI\CData $js_eval): bool
+    public function isException(\FFI\CData $run_time, int $js_eval): bool
     {
         return !$this->ffi->quickjs_is_exception($run_time, $js_eval);
     }
@@ -86,29 +142,29 @@ class QuickJs
      */
     public function getException(\FFI\CData $run_time): string
     {
-        return $this->ffi->quickjs_get_exception($run_time);
+        return $this->readString(fn ($buf, $size) => $this->ffi->quickjs_get_exception($run_time, $buf, $size));
     }
 
     /**
      * js对象转字符串 function
      *
      * @param \FFI\CData $run_time
-     * @param \FFI\CData $js_obj
+     * @param integer $js_obj JS值句柄
      * @return string
      */
-    public function toString(\FFI\CData $run_time, \FFI\CData $js_obj): string
+    public function toString(\FFI\CData $run_time, int $js_obj): string
     {
-        return $this->ffi->quickjs_js_ToCString($run_time, $js_obj);
+        return $this->readString(fn ($buf, $size) => $this->ffi->quickjs_js_ToCString($run_time, $js_obj, $buf, $size));
     }
 
     /**
      * js对象转bool function
      *
      * @param \FFI\CData $run_time
-     * @param \FFI\CData $js_obj
+     * @param integer $js_obj JS值句柄
      * @return bool
      */
-    public function toBool(\FFI\CData $run_time, \FFI\CData $js_obj): bool
+    public function toBool(\FFI\CData $run_time, int $js_obj): bool
     {
         return $this->ffi->quickjs_js_ToBool($run_time, $js_obj);
     }
@@ -117,11 +173,11 @@ class QuickJs
      * js对象转int function
      *
      * @param \FFI\CData $run_time 
-     * @param \FFI\CData $js_obj
+     * @param integer $js_obj JS值句柄
      * @param integer $pres
      * @return integer
      */
-    public function toInt(\FFI\CData $run_time, \FFI\CData $js_obj): int
+    public function toInt(\FFI\CData $run_time, int $js_obj): int
     {
         return $this->ffi->quickjs_js_ToInt($run_time, $js_obj);
     }
@@ -134,6 +190,7 @@ class QuickJs
      */
     public function free(\FFI\CData $run_time): void
     {
+        $this->removeFunctions($run_time);
         $this->ffi->quickjs_free($run_time);
     }
 
@@ -141,9 +198,9 @@ class QuickJs
      * 创建JS的undefined值 function
      *
      * @param \FFI\CData $run_time JS运行时对象
-     * @return \FFI\CData
+     * @return integer JS值句柄
      */
-    public function newUndefined(\FFI\CData $run_time): \FFI\CData
+    public function newUndefined(\FFI\CData $run_time): int
     {
         return $this->ffi->quickjs_new_undefined($run_time);
     }
@@ -152,9 +209,9 @@ class QuickJs
      * 创建JS的null值 function
      *
      * @param \FFI\CData $run_time JS运行时对象
-     * @return \FFI\CData
+     * @return integer JS值句柄
      */
-    public function newNull(\FFI\CData $run_time): \FFI\CData
+    public function newNull(\FFI\CData $run_time): int
     {
         return $this->ffi->quickjs_new_null($run_time);
     }
@@ -163,9 +220,9 @@ class QuickJs
      * 创建JS的true值 function
      *
      * @param \FFI\CData $run_time JS运行时对象
-     * @return \FFI\CData
+     * @return integer JS值句柄
      */
-    public function newTrue(\FFI\CData $run_time): \FFI\CData
+    public function newTrue(\FFI\CData $run_time): int
     {
         return $this->ffi->quickjs_new_true($run_time);
     }
@@ -174,9 +231,9 @@ class QuickJs
      * 创建JS的false值 function
      *
      * @param \FFI\CData $run_time JS运行时对象
-     * @return \FFI\CData
+     * @return integer JS值句柄
      */
-    public function newFalse(\FFI\CData $run_time): \FFI\CData
+    public function newFalse(\FFI\CData $run_time): int
     {
         return $this->ffi->quickjs_new_false($run_time);
     }
@@ -186,9 +243,9 @@ class QuickJs
      *
      * @param \FFI\CData $run_time JS运行时对象
      * @param string $str 字符串
-     * @return \FFI\CData
+     * @return integer JS值句柄
      */
-    public function newString(\FFI\CData $run_time, string $str): \FFI\CData
+    public function newString(\FFI\CData $run_time, string $str): int
     {
         return $this->ffi->quickjs_new_string($run_time, $str);
     }
@@ -198,9 +255,9 @@ class QuickJs
      *
      * @param \FFI\CData $run_time JS运行时对象
      * @param integer $int int值
-     * @return \FFI\CData
+     * @return integer JS值句柄
      */
-    public function newInt(\FFI\CData $run_time, int $int): \FFI\CData
+    public function newInt(\FFI\CData $run_time, int $int): int
     {
         return $this->ffi->quickjs_new_int($run_time, $int);
     }
@@ -210,9 +267,9 @@ class QuickJs
      *
      * @param \FFI\CData $run_time JS运行时对象
      * @param string $json json字符串
-     * @return \FFI\CData
+     * @return integer JS值句柄
      */
-    public function newJson(\FFI\CData $run_time, string $json): \FFI\CData
+    public function newJson(\FFI\CData $run_time, string $json): int
     {
         return $this->ffi->quickjs_new_json($run_time, $json);
     }
@@ -222,10 +279,879 @@ class QuickJs
      *
      * @param \FFI\CData $run_time JS运行时对象
      * @param float $float double值
-     * @return \FFI\CData
+     * @return integer JS值句柄
+     */
+    public function newFloat(\FFI\CData $run_time, float $float): int
+    {
+        return $this->ffi->quickjs_new_double($run_time, $float);
+    }
+
+    /**
+     * 设置全局变量 function
+     *
+     * @param \FFI\CData $run_time JS运行时对象
+     * @param string $name 变量名
+     * @param integer $value JS值句柄, 仍需调用 release 释放
+     * @return boolean
+     */
+    public function setPropertyStr(\FFI\CData $run_time, string $name, int $value): bool
+    {
+        return $this->ffi->quickjs_set_property_str($run_time, $name, $value) >= 0;
+    }
+
+    /**
+     * 编译JS代码为字节码 function
+     *
+     * 同一份源码在进程内只编译一次, 指定 $cache_dir 时还会落盘, 新进程可直接加载;
+     * 缓存文件等同于可执行代码, 目录须为 worker 用户所有且组和其他用户不可写 (建议0700), 否则不读写磁盘缓存, 不要使用 /tmp 等公共目录
+     *
+     * @param \FFI\CData $run_time JS运行时对象
+     * @param string $code JS代码
+     * @param string $cache_dir 磁盘缓存目录, 为空时只使用进程内缓存
+     * @return \FFI\CData|null 预编译脚本, 编译失败返回null
+     */
+    public function compile(\FFI\CData $run_time, string $code, string $cache_dir = ""): ?\FFI\CData
+    {
+        $script = $this->ffi->quickjs_compile($run_time, $code, $cache_dir === "" ? null : $cache_dir);
+        return \FFI::isNull($script) ? null : $script;
+    }
+
+    /**
+     * 执行预编译脚本 function
+     *
+     * @param \FFI\CData $run_time JS运行时对象
+     * @param \FFI\CData $script 预编译脚本
+     * @return integer JS值句柄
+     */
+    public function runCompiled(\FFI\CData $run_time, \FFI\CData $script): int
+    {
+        return $this->ffi->quickjs_run_compiled($run_time, $script);
+    }
+
+    /**
+     * 导出字节码 function
+     *
+     * 可存入 APCu/shmop 等共享内存, 再通过 scriptLoad 恢复
+     *
+     * @param \FFI\CData $script 预编译脚本
+     * @return string
+     */
+    public function scriptBytecode(\FFI\CData $script): string
+    {
+        return \FFI::string(
+            $this->ffi->quickjs_script_bytecode($script),
+            $this->ffi->quickjs_script_size($script)
+        );
+    }
+
+    /**
+     * 从字节码恢复预编译脚本 function
+     *
+     * 字节码不做校验, 等同于可执行代码, 只能加载本进程导出且未经他人修改的数据
+     *
+     * @param string $bytecode scriptBytecode 导出的字节码
+     * @return \FFI\CData 预编译脚本
+     */
+    public function scriptLoad(string $bytecode): \FFI\CData
+    {
+        return $this->ffi->quickjs_script_load($bytecode, strlen($bytecode));
+    }
+
+    /**
+     * 释放预编译脚本 function
+     *
+     * @param \FFI\CData $script 预编译脚本
+     * @return void
+     */
+    public function scriptFree(\FFI\CData $script): void
+    {
+        $this->ffi->quickjs_script_free($script);
+    }
+
+    /**
+     * 清空进程内字节码缓存 function
+     *
+     * @return void
+     */
+    public function scriptCacheClear(): void
+    {
+        $this->ffi->quickjs_script_cache_clear();
+    }
+
+    /**
+     * 重置JS运行时 function
+     *
+     * 删除用户定义的全局变量并还原内置全局对象, 已预编译的字节码保留;
+     * 调用过 trackBuiltins 的运行时 (运行时池中的运行时) 还会还原对内置原型等的修改。
+     * 内存上限、栈深度、GC阈值、超时和内存统计还原为默认值, 注册的PHP函数被移除。
+     * 顶层 let/const 声明无法清除
+     *
+     * @param \FFI\CData $run_time JS运行时对象
+     * @return boolean 内置对象被冻结、有未执行的 Promise 任务等无法还原时返回false, 运行时不应再复用
+     */
+    public function reset(\FFI\CData $run_time): bool
+    {
+        $this->removeFunctions($run_time);
+        return $this->ffi->quickjs_reset($run_time) === 1;
+    }
+
+    /**
+     * 创建JS运行时池 function
+     *
+     * @param integer $size 预热的运行时数量
+     * @param integer $max_uses 每个运行时最多复用次数, 0为不限制
+     * @return \FFI\CData 运行时池
+     */
+    public function poolCreate(int $size, int $max_uses = 0): \FFI\CData
+    {
+        return $this->ffi->quickjs_pool_create($size, $max_uses);
+    }
+
+    /**
+     * 获取进程级JS运行时池 function
+     *
+     * 同一进程内每次返回同一个池, PHP-FPM 的各个请求共享预热好的运行时; 只有首次调用的参数生效, 不需要 poolFree
+     *
+     * @param integer $size 预热的运行时数量
+     * @param integer $max_uses 每个运行时最多复用次数, 0为不限制
+     * @return \FFI\CData 运行时池
+     */
+    public function poolGlobal(int $size, int $max_uses = 0): \FFI\CData
+    {
+        return $this->ffi->quickjs_pool_global($size, $max_uses);
+    }
+
+    /**
+     * 记录内置对象 function
+     *
+     * 之后 reset 会一并还原对内置构造函数、原型对象等的修改; 须在执行任何脚本之前调用, 运行时池中的运行时已自动记录
+     *
+     * @param \FFI\CData $run_time JS运行时对象
+     * @return void
+     */
+    public function trackBuiltins(\FFI\CData $run_time): void
+    {
+        $this->ffi->quickjs_track_builtins($run_time);
+    }
+
+    /**
+     * 从池中取出JS运行时 function
+     *
+     * @param \FFI\CData $pool 运行时池
+     * @return \FFI\CData JS运行时对象, 用完后调用 poolRelease 归还, 不要调用 free
+     */
+    public function poolAcquire(\FFI\CData $pool): \FFI\CData
+    {
+        return $this->ffi->quickjs_pool_acquire($pool);
+    }
+
+    /**
+     * 归还JS运行时 function
+     *
+     * @param \FFI\CData $pool 运行时池
+     * @param \FFI\CData $run_time JS运行时对象
+     * @param boolean $discard 为true时销毁运行时而不是重置复用 (例如脚本使用了顶层 let/const); 无法还原的运行时会自动销毁
+     * @return void
+     */
+    public function poolRelease(\FFI\CData $pool, \FFI\CData $run_time, bool $discard = false): void
+    {
+        $this->removeFunctions($run_time);
+        $this->ffi->quickjs_pool_release($pool, $run_time, $discard ? 1 : 0);
+    }
+
+    /**
+     * 释放JS运行时池 function
+     *
+     * @param \FFI\CData $pool 运行时池
+     * @return void
+     */
+    public function poolFree(\FFI\CData $pool): void
+    {
+        $this->ffi->quickjs_pool_free($pool);
+    }
+
+    /**
+     * 创建JS的类型化数组 function
+     *
+     * @param \FFI\CData $run_time JS运行时对象
+     * @param \FFI\CData $data 数据, 例如 \FFI::new("double[100]")
+     * @param integer $count 元素个数
+     * @param integer $type self::TYPED_UINT8 / self::TYPED_INT32 / self::TYPED_FLOAT64
+     * @param boolean $copy 为false时JS直接引用 $data 不拷贝, 需保证JS使用期间 $data 不被释放
+     * @return integer JS值句柄
+     */
+    public function newTypedArray(\FFI\CData $run_time, \FFI\CData $data, int $count, int $type, bool $copy = true): int
+    {
+        return $this->ffi->quickjs_new_typed_array($run_time, \FFI::addr($data[0]), $count, $type, $copy ? 1 : 0);
+    }
+
+    /**
+     * PHP值转JS值 function
+     *
+     * 通过二进制缓冲区一次性构造数组/对象, 不经过 json_encode 和 JSON.parse
+     *
+     * @param \FFI\CData $run_time JS运行时对象
+     * @param mixed $value null/bool/int/float/string/array
+     * @return integer JS值句柄, 通常交给 setPropertyStr 设置为全局变量
+     */
+    public function newValue(\FFI\CData $run_time, mixed $value): int
+    {
+        $buffer = self::encodeValue($value);
+        return $this->ffi->quickjs_new_from_buffer($run_time, $buffer, strlen($buffer));
+    }
+
+    /**
+     * JS值转PHP值 function
+     *
+     * 对象转为关联数组, 类型化数组转为数字列表, 函数转为null
+     *
+     * @param \FFI\CData $run_time JS运行时对象
+     * @param integer $js_obj JS值句柄
+     * @return mixed
+     */
+    public function toValue(\FFI\CData $run_time, int $js_obj): mixed
+    {
+        $len = $this->ffi->new("size_t");
+        return $this->decodeBuffer($run_time, $this->ffi->quickjs_to_buffer($run_time, $js_obj, \FFI::addr($len)), $len);
+    }
+
+    /**
+     * 执行代码并转为PHP值 function
+     *
+     * @param \FFI\CData $run_time JS运行时对象
+     * @param string $code JS代码
+     * @return mixed
+     */
+    public function evalValue(\FFI\CData $run_time, string $code): mixed
+    {
+        $len = $this->ffi->new("size_t");
+        return $this->decodeBuffer($run_time, $this->ffi->quickjs_eval_to_buffer($run_time, $code, \FFI::addr($len)), $len);
+    }
+
+    /**
+     * 释放JS值句柄 function
+     *
+     * @param \FFI\CData $run_time JS运行时对象
+     * @param integer $js_obj JS值句柄
+     * @return boolean 句柄无效时返回false
+     */
+    public function release(\FFI\CData $run_time, int $js_obj): bool
+    {
+        return $this->ffi->quickjs_release($run_time, $js_obj) === 1;
+    }
+
+    /**
+     * 批量释放JS值句柄 function
+     *
+     * @param \FFI\CData $run_time JS运行时对象
+     * @param int[] $js_objs JS值句柄
+     * @return integer 成功释放的数量
+     */
+    public function releaseBatch(\FFI\CData $run_time, array $js_objs): int
+    {
+        $count = count($js_objs);
+        if ($count === 0) {
+            return 0;
+        }
+        $handles = $this->ffi->new("QuickJSHandle_t[$count]");
+        foreach (array_values($js_objs) as $i => $handle) {
+            $handles[$i] = $handle;
+        }
+        return $this->ffi->quickjs_release_batch($run_time, $handles, $count);
+    }
+
+    /**
+     * 释放运行时中所有JS值句柄 function
+     *
+     * @param \FFI\CData $run_time JS运行时对象
+     * @return void
+     */
+    public function releaseAll(\FFI\CData $run_time): void
+    {
+        $this->ffi->quickjs_release_all($run_time);
+    }
+
+    /**
+     * 开关调试模式 function
+     *
+     * 开启后使用无效句柄会输出到stderr, 释放运行时时报告未释放的句柄
+     *
+     * @param \FFI\CData $run_time JS运行时对象
+     * @param boolean $enable
+     * @return void
+     */
+    public function setDebug(\FFI\CData $run_time, bool $enable): void
+    {
+        $this->ffi->quickjs_set_debug($run_time, $enable ? 1 : 0);
+    }
+
+    /**
+     * 获取存活的句柄数量 function
+     *
+     * @param \FFI\CData $run_time JS运行时对象
+     * @return integer
+     */
+    public function handleCount(\FFI\CData $run_time): int
+    {
+        return $this->ffi->quickjs_handle_count($run_time);
+    }
+
+    /**
+     * 获取调试报告 function
+     *
+     * 包含存活句柄数量, 无效句柄使用次数, 每个存活句柄的类型和引用计数
+     *
+     * @param \FFI\CData $run_time JS运行时对象
+     * @return string
+     */
+    public function debugReport(\FFI\CData $run_time): string
+    {
+        return $this->readString(fn ($buf, $size) => $this->ffi->quickjs_debug_report($run_time, $buf, $size));
+    }
+
+    /**
+     * 使用专用分配器创建JS运行时 function
+     *
+     * 运行时的内存从按大小分级的 arena 中分配, 释放运行时时整块归还, 适合每个请求一个运行时的场景
+     *
+     * @param integer $chunk_size 每个 arena 的字节数, 0 为默认256KB
+     * @return \FFI\CData JS运行时对象
+     */
+    public function createArena(int $chunk_size = 0): \FFI\CData
+    {
+        return $this->ffi->quickjs_create_arena($chunk_size);
+    }
+
+    /**
+     * 获取专用分配器统计 function
+     *
+     * @param \FFI\CData $run_time JS运行时对象
+     * @return array|null peak/used/reserved/free_list/arena_count/large_count/alloc_count/fragmentation, 未使用专用分配器时返回null
+     */
+    public function allocStats(\FFI\CData $run_time): ?array
+    {
+        $stats = $this->ffi->new("QuickJSAllocStats");
+        if ($this->ffi->quickjs_alloc_stats($run_time, \FFI::addr($stats)) !== 0) {
+            return null;
+        }
+        return [
+            "peak" => $stats->peak,
+            "used" => $stats->used,
+            "reserved" => $stats->reserved,
+            "free_list" => $stats->free_list,
+            "arena_count" => $stats->arena_count,
+            "large_count" => $stats->large_count,
+            "alloc_count" => $stats->alloc_count,
+            "fragmentation" => $stats->fragmentation,
+        ];
+    }
+
+    /**
+     * 设置内存上限 function
+     *
+     * 超出时分配失败, 执行失败后 getException 返回 InternalError: out of memory;
+     * reset 或归还运行时池后还原为不限制, 以下资源设置同理
+     *
+     * @param \FFI\CData $run_time JS运行时对象
+     * @param integer $limit 字节数, 0 为不限制
+     * @return void
+     */
+    public function setMemoryLimit(\FFI\CData $run_time, int $limit): void
+    {
+        $this->ffi->quickjs_set_memory_limit($run_time, $limit);
+    }
+
+    /**
+     * 设置最大栈深度 function
+     *
+     * @param \FFI\CData $run_time JS运行时对象
+     * @param integer $stack_size 字节数, 0 为不检查
+     * @return void
+     */
+    public function setMaxStackSize(\FFI\CData $run_time, int $stack_size): void
+    {
+        $this->ffi->quickjs_set_max_stack_size($run_time, $stack_size);
+    }
+
+    /**
+     * 设置自动GC阈值 function
+     *
+     * @param \FFI\CData $run_time JS运行时对象
+     * @param integer $gc_threshold 已分配字节超过该值时触发GC, -1 为关闭自动GC
+     * @return void
+     */
+    public function setGcThreshold(\FFI\CData $run_time, int $gc_threshold): void
+    {
+        $this->ffi->quickjs_set_gc_threshold($run_time, $gc_threshold);
+    }
+
+    /**
+     * 设置单次执行超时 function
+     *
+     * 作用于 eval/runCompiled/evalValue/call/runJobs, await 中每批任务和定时器分别计时;
+     * 超时后执行结果为不可捕获的 interrupted 异常
+     *
+     * @param \FFI\CData $run_time JS运行时对象
+     * @param integer $timeout_us 微秒, 0 为不限制
+     * @param integer $check_interval 每多少次中断回调 (约一万条指令一次) 检查一次时钟
+     * @return void
+     */
+    public function setTimeout(\FFI\CData $run_time, int $timeout_us, int $check_interval = 1): void
+    {
+        $this->ffi->quickjs_set_timeout($run_time, $timeout_us, $check_interval);
+    }
+
+    /**
+     * 开关内存统计 function
+     *
+     * 开启后每次执行前后统计内存, 开销随堆大小增长
+     *
+     * @param \FFI\CData $run_time JS运行时对象
+     * @param boolean $enable
+     * @return void
+     */
+    public function setUsageTracking(\FFI\CData $run_time, bool $enable): void
+    {
+        $this->ffi->quickjs_set_usage_tracking($run_time, $enable ? 1 : 0);
+    }
+
+    /**
+     * 获取最近一次执行的资源使用 function
+     *
+     * @param \FFI\CData $run_time JS运行时对象
+     * @return array elapsed_us/malloc_size/malloc_delta/malloc_count/memory_used_size/interrupted, 未开启内存统计时内存项为-1
+     */
+    public function lastUsage(\FFI\CData $run_time): array
+    {
+        $usage = $this->ffi->new("QuickJSEvalUsage");
+        $this->ffi->quickjs_last_usage($run_time, \FFI::addr($usage));
+        return [
+            "elapsed_us" => $usage->elapsed_us,
+            "malloc_size" => $usage->malloc_size,
+            "malloc_delta" => $usage->malloc_delta,
+            "malloc_count" => $usage->malloc_count,
+            "memory_used_size" => $usage->memory_used_size,
+            "interrupted" => $usage->interrupted !== 0,
+        ];
+    }
+
+    /**
+     * 创建调用PHP函数的JS函数 function
+     *
+     * 所有PHP函数共用一个C入口, 按序号分发; 参数以句柄传入, 调用返回后自动释放
+     *
+     * @param \FFI\CData $run_time JS运行时对象
+     * @param callable $fn fn(\FFI\CData $run_time, int ...$args): ?int 返回值句柄交给JS, null 为 undefined; 抛出的异常转为JS的Error
+     * @param string $name 函数名
+     * @param integer $length 参数个数
+     * @return integer JS值句柄
+     */
+    public function newFunction(\FFI\CData $run_time, callable $fn, string $name = "", int $length = 0): int
+    {
+        if ($this->callback === null) {
+            $this->callback = $this->ffi->new("QuickJSHostCallback");
+            $this->callback->cdata = fn (\FFI\CData $quickjs, int $function_id, int $argc, ?\FFI\CData $argv): int => $this->dispatch($quickjs, $function_id, $argc, $argv);
+        }
+        $this->ffi->quickjs_set_host_callback($run_time, $this->callback);
+        $function_id = $this->nextFunctionId++;
+        $this->functions[$function_id] = $fn;
+        $this->functionIds[$this->runTimeKey($run_time)][$function_id] = true;
+        return $this->ffi->quickjs_new_function($run_time, $name, $length, $function_id);
+    }
+
+    /**
+     * 设置调用PHP函数的全局函数 function
+     *
+     * 再次设置同名函数时移除之前注册的PHP函数, 脚本仍持有的旧函数调用时抛出异常
+     *
+     * @param \FFI\CData $run_time JS运行时对象
+     * @param string $name 函数名
+     * @param callable $fn 同 newFunction
+     * @param integer $length 参数个数
+     * @return boolean
+     */
+    public function setFunction(\FFI\CData $run_time, string $name, callable $fn, int $length = 0): bool
+    {
+        $key = $this->runTimeKey($run_time);
+        if (isset($this->functionNames[$key][$name])) {
+            $function_id = $this->functionNames[$key][$name];
+            unset($this->functions[$function_id], $this->functionIds[$key][$function_id]);
+        }
+        $js_fn = $this->newFunction($run_time, $fn, $name, $length);
+        $this->functionNames[$key][$name] = $this->nextFunctionId - 1;
+        $ret = $this->setPropertyStr($run_time, $name, $js_fn);
+        $this->release($run_time, $js_fn);
+        return $ret;
+    }
+
+    /**
+     * 移除运行时注册的所有PHP函数 function
+     *
+     * reset、free、poolRelease 时自动调用; 之后JS再调用这些函数会抛出异常
+     *
+     * @param \FFI\CData $run_time JS运行时对象
+     * @return void
+     */
+    public function removeFunctions(\FFI\CData $run_time): void
+    {
+        $key = $this->runTimeKey($run_time);
+        foreach (array_keys($this->functionIds[$key] ?? []) as $function_id) {
+            unset($this->functions[$function_id]);
+        }
+        unset($this->functionIds[$key], $this->functionNames[$key]);
+    }
+
+    /**
+     * 运行时地址, 作为 functionIds 的键 function
+     *
+     * @param \FFI\CData $run_time JS运行时对象
+     * @return integer
+     */
+    protected function runTimeKey(\FFI\CData $run_time): int
+    {
+        return $this->ffi->cast("uintptr_t", $run_time)->cdata;
+    }
+
+    /**
+     * 宿主回调 function
+     *
+     * 按 function_id 调用PHP函数, PHP异常转为JS异常
+     *
+     * @param \FFI\CData $quickjs JS运行时对象
+     * @param integer $function_id
+     * @param integer $argc
+     * @param \FFI\CData|null $argv 参数句柄数组
+     * @return integer 返回值句柄, 0 为 undefined
+     */
+    protected function dispatch(\FFI\CData $quickjs, int $function_id, int $argc, ?\FFI\CData $argv): int
+    {
+        $args = [];
+        for ($i = 0; $i < $argc; $i++) {
+            $args[] = $argv[$i];
+        }
+        try {
+            if (!isset($this->functions[$function_id])) {
+                throw new \RuntimeException("host function {$function_id} not found");
+            }
+            return ($this->functions[$function_id])($quickjs, ...$args) ?? 0;
+        } catch (\Throwable $e) {
+            $this->ffi->quickjs_throw_error($quickjs, $e->getMessage());
+            return 0;
+        }
+    }
+
+    /**
+     * 调用JS函数 function
+     *
+     * @param \FFI\CData $run_time JS运行时对象
+     * @param integer $js_fn 函数句柄
+     * @param integer ...$args 参数句柄
+     * @return integer JS值句柄
+     */
+    public function call(\FFI\CData $run_time, int $js_fn, int ...$args): int
+    {
+        $argc = count($args);
+        $argv = $this->ffi->new("QuickJSHandle_t[" . max($argc, 1) . "]");
+        foreach ($args as $i => $arg) {
+            $argv[$i] = $arg;
+        }
+        return $this->ffi->quickjs_call($run_time, $js_fn, $argc, $argv);
+    }
+
+    /**
+     * 多线程批量执行 function
+     *
+     * 脚本的执行结果须为函数, 对每个输入调用 fn(input, index);
+     * 每个线程使用独立的运行时, 不能调用 newFunction 注册的PHP函数
+     *
+     * @param \FFI\CData $script 预编译脚本
+     * @param array $inputs 输入列表
+     * @param integer $threads 线程数, 0 为CPU核数
+     * @param integer $timeout_us 单个输入的超时时间(微秒), 0 为不限制
+     * @param array|null $errors 执行失败的输入, 以输入序号为键的异常信息
+     * @return array 按输入顺序排列的结果, 执行失败的为null
+     */
+    public function batchRun(\FFI\CData $script, array $inputs, int $threads = 0, int $timeout_us = 0, ?array &$errors = null): array
+    {
+        $inputs = array_values($inputs);
+        $count = count($inputs);
+        $errors = [];
+        if ($count === 0) {
+            return [];
+        }
+        $offsets = $this->ffi->new("size_t[" . ($count + 1) . "]");
+        $data = "";
+        foreach ($inputs as $i => $input) {
+            $data .= self::encodeValue($input);
+            $offsets[$i + 1] = strlen($data);
+        }
+        $batch = $this->ffi->quickjs_batch_run($script, $data, $offsets, $count, $threads, $timeout_us);
+
+        $len = $this->ffi->new("size_t");
+        $results = [];
+        for ($i = 0; $i < $count; $i++) {
+            $buffer = $this->ffi->quickjs_batch_result($batch, $i, \FFI::addr($len));
+            if (\FFI::isNull($buffer)) {
+                $results[] = null;
+                $errors[$i] = $this->readString(fn ($buf, $size) => $this->ffi->quickjs_batch_error($batch, $i, $buf, $size));
+                continue;
+            }
+            $offset = 0;
+            $results[] = self::decodeValue(\FFI::string($buffer, $len->cdata), $offset);
+        }
+        $this->ffi->quickjs_batch_free($batch);
+        return $results;
+    }
+
+    /**
+     * 执行待执行的任务和到期的定时器 function
+     *
+     * 不会阻塞等待, 适合在协程调度中分批驱动多个运行时
+     *
+     * @param \FFI\CData $run_time JS运行时对象
+     * @param integer $max_jobs 最多执行的个数, 0 为不限制
+     * @param integer $max_us 最长执行时间(微秒), 0 为不限制
+     * @return integer 执行的个数
+     * @throws \Exception 任务或定时器抛出异常时
      */
-    public function newFloat(\FFI\CData $run_time, float $float): \FFI\CData
+    public function runJobs(\FFI\CData $run_time, int $max_jobs = 0, int $max_us = 0): int
     {
-        return $this->ffi->quickjs_new_float($run_time, $float);
+        $count = $this->ffi->quickjs_run_jobs($run_time, $max_jobs, $max_us);
+        if ($count < 0) {
+            throw new \Exception($this->getException($run_time));
+        }
+        return $count;
+    }
+
+    /**
+     * 查询是否还有待执行的工作 function
+     *
+     * @param \FFI\CData $run_time JS运行时对象
+     * @return integer -1 为没有, 0 为有可以立即执行的任务, 大于0为距下一个定时器到期的微秒数
+     */
+    public function pending(\FFI\CData $run_time): int
+    {
+        return $this->ffi->quickjs_pending($run_time);
+    }
+
+    /**
+     * 获取Promise的状态 function
+     *
+     * @param \FFI\CData $run_time JS运行时对象
+     * @param integer $js_obj JS值句柄
+     * @return integer -1 不是Promise, 其他见 PROMISE_* 常量
+     */
+    public function promiseState(\FFI\CData $run_time, int $js_obj): int
+    {
+        return $this->ffi->quickjs_promise_state($run_time, $js_obj);
+    }
+
+    /**
+     * 等待Promise完成 function
+     *
+     * 期间执行任务和定时器, 没有可执行的任务时休眠到下一个定时器到期, 会阻塞当前进程
+     *
+     * @param \FFI\CData $run_time JS运行时对象
+     * @param integer $js_obj JS值句柄
+     * @param integer $max_us 最长等待时间(微秒), 0 为不限制
+     * @return integer JS值句柄, 拒绝或超时时为异常
+     */
+    public function await(\FFI\CData $run_time, int $js_obj, int $max_us = 0): int
+    {
+        return $this->ffi->quickjs_await($run_time, $js_obj, $max_us);
+    }
+
+    /**
+     * 获取运行时累计计数 function
+     *
+     * 计数随运行时常开, 可直接用于生产监控
+     *
+     * @param \FFI\CData $run_time JS运行时对象
+     * @return array evals/allocations/gc_runs/parse_us/execute_us/host_calls/jobs
+     */
+    public function getCounters(\FFI\CData $run_time): array
+    {
+        $counters = $this->ffi->new("QuickJSCounters");
+        $this->ffi->quickjs_get_counters($run_time, \FFI::addr($counters));
+        return [
+            "evals" => $counters->evals,
+            "allocations" => $counters->allocations,
+            "gc_runs" => $counters->gc_runs,
+            "parse_us" => $counters->parse_us,
+            "execute_us" => $counters->execute_us,
+            "host_calls" => $counters->host_calls,
+            "jobs" => $counters->jobs,
+        ];
+    }
+
+    /**
+     * 清零运行时累计计数 function
+     *
+     * @param \FFI\CData $run_time JS运行时对象
+     * @return void
+     */
+    public function resetCounters(\FFI\CData $run_time): void
+    {
+        $this->ffi->quickjs_reset_counters($run_time);
+    }
+
+    /**
+     * 执行GC function
+     *
+     * @param \FFI\CData $run_time JS运行时对象
+     * @return void
+     */
+    public function runGc(\FFI\CData $run_time): void
+    {
+        $this->ffi->quickjs_run_gc($run_time);
+    }
+
+    /**
+     * 读取拷贝到缓冲区的字符串 function
+     *
+     * @param callable $copy fn(\FFI\CData $buf, int $size): int 返回完整长度
+     * @return string
+     */
+    protected function readString(callable $copy): string
+    {
+        if ($this->buffer === null) {
+            $this->buffer = $this->ffi->new("char[4096]");
+        }
+        $size = \FFI::sizeof($this->buffer);
+        $len = $copy($this->buffer, $size);
+        if ($len >= $size) {
+            $this->buffer = $this->ffi->new("char[" . ($len + 1) . "]");
+            $len = $copy($this->buffer, $len + 1);
+        }
+        return \FFI::string($this->buffer, $len);
+    }
+
+    /**
+     * 读取二进制缓冲区 function
+     *
+     * @param \FFI\CData $run_time
+     * @param \FFI\CData $buffer
+     * @param \FFI\CData $len
+     * @return mixed
+     */
+    protected function decodeBuffer(\FFI\CData $run_time, \FFI\CData $buffer, \FFI\CData $len): mixed
+    {
+        if (\FFI::isNull($buffer)) {
+            throw new \Exception($this->getException($run_time));
+        }
+        $data = \FFI::string($buffer, $len->cdata);
+        $offset = 0;
+        return self::decodeValue($data, $offset);
+    }
+
+    /**
+     * PHP值编码为二进制格式 function
+     *
+     * @param mixed $value
+     * @return string
+     */
+    protected static function encodeValue(mixed $value): string
+    {
+        switch (true) {
+            case $value === null:
+                return "\x01";
+            case $value === false:
+                return "\x02";
+            case $value === true:
+                return "\x03";
+            case is_int($value):
+                if ($value >= -2147483648 && $value <= 2147483647) {
+                    return "\x04" . pack("V", $value);
+                }
+                return "\x05" . pack("e", $value);
+            case is_float($value):
+                return "\x05" . pack("e", $value);
+            case is_string($value):
+                return "\x06" . pack("V", strlen($value)) . $value;
+            case is_array($value):
+                if (array_is_list($value)) {
+                    $out = "\x07" . pack("V", count($value));
+                    foreach ($value as $item) {
+                        $out .= self::encodeValue($item);
+                    }
+                    return $out;
+                }
+                $out = "\x08" . pack("V", count($value));
+                foreach ($value as $key => $item) {
+                    $key = (string)$key;
+                    $out .= pack("V", strlen($key)) . $key . self::encodeValue($item);
+                }
+                return $out;
+            default:
+                throw new \Exception("不支持的类型: " . get_debug_type($value));
+        }
+    }
+
+    /**
+     * 二进制格式解码为PHP值 function
+     *
+     * @param string $data
+     * @param integer $offset
+     * @return mixed
+     */
+    protected static function decodeValue(string $data, int &$offset): mixed
+    {
+        $type = ord($data[$offset++]);
+        switch ($type) {
+            case 0:
+            case 1:
+                return null;
+            case 2:
+                return false;
+            case 3:
+                return true;
+            case 4:
+                $value = unpack("V", $data, $offset)[1];
+                $offset += 4;
+                return $value >= 0x80000000 ? $value - 0x100000000 : $value;
+            case 5:
+                $value = unpack("e", $data, $offset)[1];
+                $offset += 8;
+                return $value;
+        }
+        $count = unpack("V", $data, $offset)[1];
+        $offset += 4;
+        switch ($type) {
+            case 6:
+                $value = substr($data, $offset, $count);
+                $offset += $count;
+                return $value;
+            case 7:
+                $value = [];
+                for ($i = 0; $i < $count; $i++) {
+                    $value[] = self::decodeValue($data, $offset);
+                }
+                return $value;
+            case 8:
+                $value = [];
+                for ($i = 0; $i < $count; $i++) {
+                    $key_len = unpack("V", $data, $offset)[1];
+                    $key = substr($data, $offset + 4, $key_len);
+                    $offset += 4 + $key_len;
+                    $value[$key] = self::decodeValue($data, $offset);
+                }
+                return $value;
+            case self::TYPED_UINT8:
+                $value = $count ? array_values(unpack("C{$count}", $data, $offset)) : [];
+                $offset += $count;
+                return $value;
+            case self::TYPED_INT32:
+                $offset = ($offset + 3) & ~3;
+                $value = $count ? array_values(unpack("l{$count}", $data, $offset)) : [];
+                $offset += $count * 4;
+                return $value;
+            case self::TYPED_FLOAT64:
+                $offset = ($offset + 7) & ~7;
+                $value = $count ? array_values(unpack("e{$count}", $data, $offset)) : [];
+                $offset += $count * 8;
+                return $value;
+            default:
+                throw new \Exception("无效的二进制数据");
+        }
     }
 }